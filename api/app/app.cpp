@@ -15,6 +15,7 @@
 #include "helpers.h"
 #include "errors.h"
 #include "server/neuserver.h"
+#include "server/router.h"
 #include "api/app/app.h"
 #include "api/window/window.h"
 #include "api/os/os.h"
@@ -146,5 +147,23 @@ json writeProcessError(const json &input) {
     return output;
 }
 
+json cancelCall(const json &input) {
+    json output;
+    if(!helpers::hasRequiredFields(input, {"id"})) {
+        output["error"] = errors::makeMissingArgErrorPayload("id");
+        return output;
+    }
+    string id = input["id"].get<string>();
+
+    // Only calls of the same connection can be cancelled
+    if(router::cancelCall(router::getCurrentConnection(), id)) {
+        output["success"] = true;
+    }
+    else {
+        output["error"] = errors::makeErrorPayload(errors::NE_RT_NOCALLE, id);
+    }
+    return output;
+}
+
 } // namespace controllers
 } // namespace app
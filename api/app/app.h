@@ -22,6 +22,7 @@ json broadcast(const json &input);
 json readProcessInput(const json &input);
 json writeProcessOutput(const json &input);
 json writeProcessError(const json &input);
+json cancelCall(const json &input);
 
 } // namespace controllers
 
@@ -2,7 +2,6 @@
 
 #include "lib/json/json.hpp"
 #include "lib/clip/clip.h"
-#include "lib/base64/base64.hpp"
 #include "helpers.h"
 #include "errors.h"
 #include "api/clipboard/clipboard.h"
@@ -69,7 +68,7 @@ json readImage(const json &input) {
             { "blueShift", spec.blue_shift },
             { "alphaMask", spec.alpha_mask },
             { "alphaShift", spec.alpha_shift },
-            { "data", base64::to_base64(clipData) }
+            { "data", helpers::binaryToJson(clipData) }
         };
     }
 
@@ -101,7 +100,7 @@ json writeImage(const json &input) {
     spec.alpha_mask = input["alphaMask"].get<unsigned long>();
     spec.alpha_shift = input["alphaShift"].get<unsigned long>();
 
-    string clipData = base64::from_base64(input["data"].get<string>());
+    string clipData = helpers::jsonToBinary(input["data"]);
     clip::image image(clipData.data(), spec);
     clip::set_image(image);
 
@@ -16,7 +16,7 @@ using json = nlohmann::json;
 
 namespace custom {
 vector<string> getMethods() {
-    auto methodMap = router::getMethodMap();
+    const auto &methodMap = router::getMethodMap();
     vector<string> customMethods = {};
     for(const auto &[methodName, _]: methodMap) {
         if(methodName == "custom.getMethods") {
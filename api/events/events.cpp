@@ -33,6 +33,10 @@ bool dispatchToExtension(const string &extensionId, const string &event, const j
     return neuserver::sendToExtension(extensionId, __makeEventPayload(event, data));
 }
 
+bool dispatchToConnection(websocketpp::connection_hdl connection, const string &event, const json &data) {
+    return neuserver::sendToConnection(connection, __makeEventPayload(event, data));
+}
+
 namespace controllers {
 
 json broadcast(const json &input) {
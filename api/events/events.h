@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include <websocketpp/common/connection_hdl.hpp>
+
 #include "lib/json/json.hpp"
 
 using namespace std;
@@ -15,6 +17,8 @@ void dispatchToAllExtensions(const string &event, const json &data); // notifies
 void dispatchToAllApps(const string &event, const json &data); // notifies all app clients
 bool dispatchToExtension(const string &extensionId, const string &event, const json &data);
 //notifies specific ext client
+bool dispatchToConnection(websocketpp::connection_hdl connection, const string &event, const json &data);
+// notifies one client, returns false if it's not connected
 
 namespace controllers {
 
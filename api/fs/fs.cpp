@@ -27,14 +27,15 @@
 
 #include <efsw/efsw.hpp>
 #include "lib/json/json.hpp"
-#include "lib/base64/base64.hpp"
 #include "lib/platformfolders/platform_folders.h"
 #include "settings.h"
 #include "helpers.h"
 #include "errors.h"
+#include "resources.h"
 #include "api/fs/fs.h"
 #include "api/os/os.h"
 #include "api/events/events.h"
+#include "server/router.h"
 
 using namespace std;
 using json = nlohmann::json;
@@ -94,7 +95,7 @@ void __readStreamBlock(const OpenedFileEvent &evt, ifstream *reader, vector<char
     string result(buffer.begin(), buffer.end());
 
     if(regex_match(evt.type, regex(".*Binary$"))) {
-        __dispatchOpenedFileEvt(evt.id, "dataBinary", base64::to_base64(result));
+        __dispatchOpenedFileEvt(evt.id, "dataBinary", helpers::binaryToJson(result));
     }
     else {
         __dispatchOpenedFileEvt(evt.id, "data", result);
@@ -155,7 +156,6 @@ fs::FileReaderResult readFile(const string &filename, const fs::FileReaderOption
         fileReaderResult.status = errors::NE_FS_FILRDER;
         return fileReaderResult;
     }
-    vector<char> buffer;
     long long origSize = reader.tellg();
     long long size = origSize;
     long long pos = 0;
@@ -169,16 +169,61 @@ fs::FileReaderResult readFile(const string &filename, const fs::FileReaderOption
     }
     reader.seekg(pos, ios::beg);
 
-    buffer.resize(size);
-    reader.read(buffer.data(), size);
-    string result(buffer.begin(), buffer.end());
+    fileReaderResult.data.resize(size);
+    reader.read(fileReaderResult.data.data(), size);
     reader.close();
-
-    fileReaderResult.data = result;
     return fileReaderResult;
 }
 
+// Windows doesn't delete a mapped file, so renaming over it fails. The mapped
+// file can be renamed though, so it's moved aside before the new file takes
+// its place. The old file gets removed once nothing maps it anymore.
+bool __swapFile(const string &tempFilename, const string &filename) {
+    #if defined(_WIN32)
+    wstring oldFilename = CONVSTR(filename + NEU_REPLACED_FILE_SUFFIX);
+    DeleteFileW(oldFilename.c_str());
+    if(!MoveFileExW(CONVSTR(filename).c_str(), oldFilename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        return false;
+    }
+    if(!MoveFileExW(CONVSTR(tempFilename).c_str(), CONVSTR(filename).c_str(), 0)) {
+        MoveFileExW(oldFilename.c_str(), CONVSTR(filename).c_str(), 0);
+        return false;
+    }
+    DeleteFileW(oldFilename.c_str());
+    return true;
+    #else
+    error_code ec;
+    filesystem::rename(CONVSTR(tempFilename), CONVSTR(filename), ec);
+    return !ec;
+    #endif
+}
+
+// Writes a new file next to the original and swaps it with the original,
+// so readers of the original (i.e., a mapping) keep its old content
+bool __replaceFile(const string &filename, const string &data) {
+    string tempFilename = filename + ".tmp";
+    ofstream writer(CONVSTR(tempFilename), ios_base::out | ios_base::binary);
+    if(!writer.is_open()) {
+        return false;
+    }
+    writer << data;
+    writer.close();
+    error_code ec;
+    if(!writer.fail()) {
+        filesystem::permissions(CONVSTR(tempFilename), filesystem::status(CONVSTR(filename), ec).permissions(), ec);
+    }
+    if(writer.fail() || !__swapFile(tempFilename, filename)) {
+        filesystem::remove(CONVSTR(tempFilename), ec);
+        return false;
+    }
+    return true;
+}
+
 bool writeFile(const fs::FileWriterOptions &fileWriterOptions) {
+    // The app reads resources.neu from a mapping while the updater writes a new one
+    if(!fileWriterOptions.append && resources::isMappedFile(fileWriterOptions.filename)) {
+        return __replaceFile(fileWriterOptions.filename, fileWriterOptions.data);
+    }
     json output;
     ios_base::openmode mode = ios_base::out | ios_base::binary;
     // For portability we use LF ('\n') always via ::binary
@@ -331,6 +376,11 @@ fs::DirReaderResult readDirectory(const string &path, bool recursive) {
         entry != filesystem::recursive_directory_iterator();
         ++entry) {
 
+        // Stop walking large trees if the client cancelled the native call
+        if(router::isCurrentCallCancelled()) {
+            break;
+        }
+
         fs::EntryType type = fs::EntryTypeOther;
         if(entry->is_directory()) {
             type = fs::EntryTypeDir;
@@ -396,7 +446,7 @@ json __writeOrAppendBinaryFile(const json &input, bool append = false) {
     }
     fs::FileWriterOptions fileWriterOptions;
     fileWriterOptions.filename = input["path"].get<string>();
-    fileWriterOptions.data = base64::from_base64(input["data"].get<string>());
+    fileWriterOptions.data = helpers::jsonToBinary(input["data"]);
     fileWriterOptions.append = append;
 
     if(fs::writeFile(fileWriterOptions))
@@ -490,7 +540,7 @@ json readBinaryFile(const json &input) {
         output["error"] = errors::makeErrorPayload(fileReaderResult.status, path);
     }
     else {
-        output["returnValue"] = base64::to_base64(fileReaderResult.data);
+        output["returnValue"] = helpers::binaryToJson(fileReaderResult.data);
         output["success"] = true;
     }
     return output;
@@ -7,6 +7,9 @@
 #include "errors.h"
 #include "lib/json/json.hpp"
 
+// On Windows, a mapped file that gets replaced is moved aside with this suffix
+#define NEU_REPLACED_FILE_SUFFIX ".old"
+
 using json = nlohmann::json;
 using namespace std;
 
@@ -15,6 +15,8 @@
 #include <functional>
 #include <atomic>
 #include <climits>
+#include <chrono>
+#include <future>
 
 #include "resources.h"
 #include "lib/tinyprocess/process.hpp"
@@ -23,6 +25,7 @@
 
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
 #include <unistd.h>
+#include <signal.h>
 extern char **environ;
 #endif
 
@@ -47,13 +50,20 @@ extern char **environ;
 #include "errors.h"
 #include "settings.h"
 #include "resources.h"
+#include "scheduler.h"
+#include "server/router.h"
 #include "api/events/events.h"
 #include "api/fs/fs.h"
 #include "api/debug/debug.h"
 #include "api/os/os.h"
+#include "api/os/processreactor.h"
+#include "api/os/processpool.h"
 #include "api/window/window.h"
 
 #define NEU_MAX_TRAY_MENU_ITEMS 50
+#define NEU_COMMAND_OUTPUT_RESERVE 65536
+#define NEU_PROCESS_OUTPUT_MAX_BUFFER 1048576
+#define NEU_COMMAND_KILL_GRACE_PERIOD 2000
 
 using namespace std;
 using json = nlohmann::json;
@@ -69,16 +79,128 @@ bool trayInitialized = false;
 #if defined(__linux__) || defined(__FreeBSD__)
 bool useOtherTempTrayIcon = true;
 #endif
-map<int, TinyProcessLib::Process*> spawnedProcesses;
+map<int, shared_ptr<TinyProcessLib::Process>> spawnedProcesses;
 mutex spawnedProcessesLock;
 atomic<int> nextVirtualPid(0);
 
-void __dispatchSpawnedProcessEvt(int virtualPid, const string &action, const json &data) {
+// Captured output of a command. With a limit, it keeps the first and the last
+// bytes of the output and drops the middle.
+struct CommandOutput {
+    string head;
+    // Ring buffer of the last bytes, the oldest byte is at tailStart
+    string tail;
+    size_t tailStart = 0;
+    size_t headLimit = SIZE_MAX;
+    size_t tailLimit = 0;
+    size_t size = 0;
+};
+
+struct RunningCommand {
+    shared_ptr<TinyProcessLib::Process> process;
+    os::CommandOutput stdOut;
+    os::CommandOutput stdErr;
+    scheduler::TaskPtr timeoutTask;
+    atomic<bool> timedOut{false};
+    atomic<bool> terminating{false};
+    atomic<bool> exited{false};
+};
+
+// Pending output of a spawned process. The line and coalesce output modes
+// buffer chunks here, so heavy output is sent with fewer, larger events.
+struct ProcessOutput {
+    int virtualPid = -1;
+    websocketpp::connection_hdl connection;
+    os::OutputMode mode = os::OutputModeRaw;
+    chrono::milliseconds interval;
+    bool binary = false;
+    mutex lock;
+    string stdOut;
+    string stdErr;
+    scheduler::TaskPtr flushTask;
+};
+
+// Events go to the connection that spawned the process. Once it's gone
+// (i.e., after a page reload), they are broadcast as before.
+void __dispatchSpawnedProcessEvt(int virtualPid, const string &action, json &&data,
+    const websocketpp::connection_hdl &connection) {
     json evt;
     evt["id"] = virtualPid;
     evt["action"] = action;
-    evt["data"] = data;
-    events::dispatch("spawnedProcess", evt);
+    evt["data"] = move(data);
+    if(connection.expired() || !events::dispatchToConnection(connection, "spawnedProcess", evt)) {
+        events::dispatch("spawnedProcess", evt);
+    }
+}
+
+void __sendProcessOutput(os::ProcessOutput &output, const string &action, const char *bytes, size_t n) {
+    json data = output.binary ? json::binary(json::binary_t::container_type(bytes, bytes + n)) :
+                json(string(bytes, n));
+    __dispatchSpawnedProcessEvt(output.virtualPid, action, move(data), output.connection);
+}
+
+// Sends the buffered output, the caller holds the output lock
+void __flushProcessOutput(os::ProcessOutput &output) {
+    if(!output.stdOut.empty()) {
+        __sendProcessOutput(output, "stdOut", output.stdOut.data(), output.stdOut.size());
+        output.stdOut.clear();
+    }
+    if(!output.stdErr.empty()) {
+        __sendProcessOutput(output, "stdErr", output.stdErr.data(), output.stdErr.size());
+        output.stdErr.clear();
+    }
+}
+
+void __writeProcessOutput(const shared_ptr<os::ProcessOutput> &output, const string &action,
+    const char *bytes, size_t n) {
+    if(output->mode == os::OutputModeRaw) {
+        __sendProcessOutput(*output, action, bytes, n);
+        return;
+    }
+    // Events are sent under the lock, so a flush timer can't reorder them
+    lock_guard<mutex> guard(output->lock);
+    string &buffer = action == "stdOut" ? output->stdOut : output->stdErr;
+    // Only the new bytes can end a line, the buffer holds a partial line
+    size_t lineEnd = string_view(bytes, n).rfind('\n');
+    if(lineEnd != string::npos) {
+        lineEnd += buffer.size();
+    }
+    buffer.append(bytes, n);
+    if(output->mode == os::OutputModeLine) {
+        if(lineEnd != string::npos) {
+            __sendProcessOutput(*output, action, buffer.data(), lineEnd + 1);
+            buffer.erase(0, lineEnd + 1);
+        }
+        else if(buffer.size() >= NEU_PROCESS_OUTPUT_MAX_BUFFER) {
+            __sendProcessOutput(*output, action, buffer.data(), buffer.size());
+            buffer.clear();
+        }
+        return;
+    }
+    if(output->stdOut.size() + output->stdErr.size() >= NEU_PROCESS_OUTPUT_MAX_BUFFER) {
+        __flushProcessOutput(*output);
+        return;
+    }
+    if(!output->flushTask) {
+        // The reader may hold the lock while it waits for a slow client, so the
+        // scheduler thread doesn't wait for the lock but retries on the next tick
+        output->flushTask = scheduler::setInterval([output]() {
+            unique_lock<mutex> guard(output->lock, try_to_lock);
+            if(!guard.owns_lock()) {
+                return;
+            }
+            scheduler::cancel(output->flushTask);
+            output->flushTask = nullptr;
+            __flushProcessOutput(*output);
+        }, output->interval);
+    }
+}
+
+// Sends the rest of the output before the exit event
+void __closeProcessOutput(const shared_ptr<os::ProcessOutput> &output) {
+    lock_guard<mutex> guard(output->lock);
+    scheduler::cancel(output->flushTask);
+    output->flushTask = nullptr;
+    __flushProcessOutput(*output);
 }
 
 bool isTrayInitialized() {
@@ -105,53 +227,195 @@ void open(const string &url) {
     #endif
 }
 
+void __initCommandOutput(os::CommandOutput &output, size_t limit) {
+    if(limit > 0) {
+        output.tailLimit = limit / 2;
+        output.headLimit = limit - output.tailLimit;
+    }
+    output.head.reserve(min(output.headLimit, (size_t) NEU_COMMAND_OUTPUT_RESERVE));
+}
+
+void __appendCommandOutput(os::CommandOutput &output, const char *bytes, size_t n) {
+    output.size += n;
+    size_t headBytes = min(n, output.headLimit - output.head.size());
+    output.head.append(bytes, headBytes);
+    bytes += headBytes;
+    n -= headBytes;
+    if(n == 0 || output.tailLimit == 0) {
+        return;
+    }
+    if(n >= output.tailLimit) {
+        output.tail.assign(bytes + n - output.tailLimit, output.tailLimit);
+        output.tailStart = 0;
+        return;
+    }
+    size_t fillBytes = min(n, output.tailLimit - output.tail.size());
+    output.tail.append(bytes, fillBytes);
+    bytes += fillBytes;
+    n -= fillBytes;
+    // Overwrites the oldest bytes once the ring buffer is full
+    while(n > 0) {
+        size_t chunkSize = min(n, output.tailLimit - output.tailStart);
+        output.tail.replace(output.tailStart, chunkSize, bytes, chunkSize);
+        output.tailStart = (output.tailStart + chunkSize) % output.tailLimit;
+        bytes += chunkSize;
+        n -= chunkSize;
+    }
+}
+
+string __getCommandOutput(os::CommandOutput &output, bool &truncated) {
+    truncated = output.size > output.head.size() + output.tail.size();
+    if(output.tail.empty()) {
+        return move(output.head);
+    }
+    string data = move(output.head);
+    data.reserve(data.size() + output.tail.size());
+    data.append(output.tail, output.tailStart, string::npos);
+    data.append(output.tail, 0, output.tailStart);
+    return data;
+}
+
 os::CommandResult execCommand(string command, const os::ChildProcessOptions &options) {
+    auto resultPromise = make_shared<promise<os::CommandResult>>();
+    future<os::CommandResult> result = resultPromise->get_future();
+    os::execCommand(command, options, [resultPromise](const os::CommandResult &commandResult) {
+        resultPromise->set_value(commandResult);
+    });
+    return result.get(); // sync wait
+}
+
+// Asks the command to terminate and kills it if it's still running after a grace
+// period. Signals go to the command's process group, so the processes it started
+// (i.e., of a shell) don't keep running and holding its output pipes.
+void __terminateCommand(const shared_ptr<os::RunningCommand> &runningCommand) {
+    runningCommand->process->kill(true);
+    #if !defined(_WIN32)
+    if(runningCommand->terminating.exchange(true) || !scheduler::getIoContext()) {
+        return;
+    }
+    weak_ptr<os::RunningCommand> weakCommand = runningCommand;
+    int pid = runningCommand->process->get_id();
+    scheduler::setTimeout([weakCommand, pid]() {
+        shared_ptr<os::RunningCommand> runningCommand = weakCommand.lock();
+        // The group outlives the reaped command while its children are running
+        if(runningCommand && !runningCommand->exited && pid > 0) {
+            ::kill(-pid, SIGKILL);
+        }
+    }, chrono::milliseconds(NEU_COMMAND_KILL_GRACE_PERIOD));
+    #endif
+}
+
+// Starts the command and returns without waiting for it. The result handler
+// gets called once the process exits (right away for background commands).
+// Returns a function that kills the process.
+function<void()> execCommand(string command, const os::ChildProcessOptions &options,
+    const os::CommandResultHandler &resultHandler) {
     #if defined(_WIN32)
     command = "cmd.exe /c \"" + command + "\"";
     #endif
 
-    os::CommandResult commandResult;
-    TinyProcessLib::Process *childProcess;
+    shared_ptr<os::RunningCommand> runningCommand = make_shared<os::RunningCommand>();
     TinyProcessLib::Process::environment_type processEnv;
+    bool openStdIn = !options.stdIn.empty();
 
     for(const auto& [key, value]: options.envs) {
         processEnv[CONVSTR(key)] = CONVSTR(value);
     }
 
-    auto stdOutHandler = [&](const char *bytes, size_t n) {
-        commandResult.stdOut += string(bytes, n);
+    if(options.background) {
+        if(options.envs.empty()) {
+            runningCommand->process = make_shared<TinyProcessLib::Process>(CONVSTR(command), CONVSTR(options.cwd), nullptr, nullptr, openStdIn);
+        }
+        else {
+            runningCommand->process = make_shared<TinyProcessLib::Process>(CONVSTR(command), CONVSTR(options.cwd), processEnv, nullptr, nullptr, openStdIn);
+        }
+        if(openStdIn) {
+            runningCommand->process->write(options.stdIn);
+            runningCommand->process->close_stdin();
+        }
+        os::CommandResult commandResult;
+        commandResult.pid = runningCommand->process->get_id();
+        resultHandler(commandResult);
+        return [](){};
+    }
+
+    __initCommandOutput(runningCommand->stdOut, options.maxOutputBytes);
+    __initCommandOutput(runningCommand->stdErr, options.maxOutputBytes);
+
+    // Output handlers are owned by the process, so they don't keep the command alive
+    os::RunningCommand *capture = runningCommand.get();
+    auto stdOutHandler = [capture, handler = options.stdOutHandler](const char *bytes, size_t n) {
+        __appendCommandOutput(capture->stdOut, bytes, n);
+        if(handler) {
+            handler(bytes, n);
+        }
     };
 
-    auto stdErrHandler = [&](const char *bytes, size_t n) {
-        commandResult.stdErr += string(bytes, n);
+    auto stdErrHandler = [capture, handler = options.stdErrHandler](const char *bytes, size_t n) {
+        __appendCommandOutput(capture->stdErr, bytes, n);
+        if(handler) {
+            handler(bytes, n);
+        }
     };
 
-    if(!options.background && options.envs.empty()) { 
-        childProcess = new TinyProcessLib::Process(CONVSTR(command), CONVSTR(options.cwd), stdOutHandler, stdErrHandler, !options.stdIn.empty());
-    }
-    else if(options.background && options.envs.empty()) {
-        childProcess = new TinyProcessLib::Process(CONVSTR(command), CONVSTR(options.cwd), nullptr, nullptr, !options.stdIn.empty());
-    }
-    else if(!options.background && !options.envs.empty()) {
-        childProcess = new TinyProcessLib::Process(CONVSTR(command), CONVSTR(options.cwd), processEnv, stdOutHandler, stdErrHandler, !options.stdIn.empty());
+    TinyProcessLib::Config processConfig;
+    bool useReactor = processreactor::init();
+    processConfig.read_in_thread = !useReactor;
+
+    if(options.envs.empty()) {
+        runningCommand->process = make_shared<TinyProcessLib::Process>(CONVSTR(command), CONVSTR(options.cwd), stdOutHandler, stdErrHandler, openStdIn, processConfig);
     }
     else {
-        childProcess = new TinyProcessLib::Process(CONVSTR(command), CONVSTR(options.cwd), processEnv, nullptr, nullptr, !options.stdIn.empty());
+        runningCommand->process = make_shared<TinyProcessLib::Process>(CONVSTR(command), CONVSTR(options.cwd), processEnv, stdOutHandler, stdErrHandler, openStdIn, processConfig);
     }
-    
-    commandResult.pid = childProcess->get_id();
 
-    if(!options.stdIn.empty()) {
-        childProcess->write(options.stdIn);
-        childProcess->close_stdin();
+    weak_ptr<os::RunningCommand> weakCommand = runningCommand;
+    auto killCommand = [weakCommand]() {
+        if(shared_ptr<os::RunningCommand> runningCommand = weakCommand.lock()) {
+            __terminateCommand(runningCommand);
+        }
+    };
+
+    if(options.timeout > 0 && scheduler::getIoContext()) {
+        runningCommand->timeoutTask = scheduler::setTimeout([weakCommand]() {
+            if(shared_ptr<os::RunningCommand> runningCommand = weakCommand.lock()) {
+                runningCommand->timedOut = true;
+                __terminateCommand(runningCommand);
+            }
+        }, chrono::milliseconds(options.timeout));
+    }
+
+    int pid = runningCommand->process->get_id();
+    auto exitHandler = [runningCommand, resultHandler, pid](int exitCode) {
+        runningCommand->exited = true;
+        scheduler::cancel(runningCommand->timeoutTask);
+        os::CommandResult commandResult;
+        commandResult.pid = pid;
+        commandResult.exitCode = exitCode;
+        commandResult.stdOut = __getCommandOutput(runningCommand->stdOut, commandResult.stdOutTruncated);
+        commandResult.stdErr = __getCommandOutput(runningCommand->stdErr, commandResult.stdErrTruncated);
+        commandResult.timedOut = runningCommand->timedOut;
+        resultHandler(commandResult);
+    };
+
+    // Output is read before writing stdin, so a child that writes before
+    // reading its input can't block on a full pipe
+    if(!useReactor || !processreactor::watch(runningCommand->process, stdOutHandler, stdErrHandler, exitHandler)) {
+        shared_ptr<TinyProcessLib::Process> childProcess = runningCommand->process;
+        // Nothing reads the pipes yet if the process was created for the reactor
+        childProcess->start_read_thread();
+        thread processThread([=](){
+            exitHandler(childProcess->get_exit_status()); // sync wait
+        });
+        processThread.detach();
     }
 
-    if(!options.background) {
-        commandResult.exitCode = childProcess->get_exit_status(); // sync wait
+    if(openStdIn) {
+        runningCommand->process->write(options.stdIn);
+        runningCommand->process->close_stdin();
     }
 
-    delete childProcess;
-    return commandResult;
+    return killCommand;
 }
 
 pair<int, int> spawnProcess(string command, const os::ChildProcessOptions &options) {
@@ -159,7 +423,7 @@ pair<int, int> spawnProcess(string command, const os::ChildProcessOptions &optio
     command = "cmd.exe /c \"" + command + "\"";
     #endif
 
-    TinyProcessLib::Process *childProcess;
+    shared_ptr<TinyProcessLib::Process> childProcess;
     lock_guard<mutex> guard(spawnedProcessesLock);
 
     int virtualPid = nextVirtualPid++;
@@ -168,9 +432,16 @@ pair<int, int> spawnProcess(string command, const os::ChildProcessOptions &optio
     }
 
 
+    shared_ptr<os::ProcessOutput> output = make_shared<os::ProcessOutput>();
+    output->virtualPid = virtualPid;
+    output->connection = options.connection;
+    output->mode = options.outputMode;
+    output->interval = chrono::milliseconds(options.outputInterval);
+    output->binary = options.binaryOutput;
+
     auto stdOutHandler = [=](const char *bytes, size_t n) {
         if(options.events) {
-            __dispatchSpawnedProcessEvt(virtualPid, "stdOut", string(bytes, n));
+            __writeProcessOutput(output, "stdOut", bytes, n);
         }
         if(options.stdOutHandler != nullptr) {
             options.stdOutHandler(bytes, n);
@@ -179,49 +450,69 @@ pair<int, int> spawnProcess(string command, const os::ChildProcessOptions &optio
 
     auto stdErrHandler = [=](const char *bytes, size_t n) {
         if(options.events) {
-            __dispatchSpawnedProcessEvt(virtualPid, "stdErr", string(bytes, n));
+            __writeProcessOutput(output, "stdErr", bytes, n);
         }
         if(options.stdErrHandler != nullptr) {
             options.stdErrHandler(bytes, n);
         }
     };
 
+    // The process reactor reads the output of all processes from one thread
+    TinyProcessLib::Config processConfig;
+    bool useReactor = processreactor::init();
+    processConfig.read_in_thread = !useReactor;
+
     if(options.envs.empty()) {
-        childProcess = new TinyProcessLib::Process(CONVSTR(command), CONVSTR(options.cwd), stdOutHandler, stdErrHandler, true);
+        childProcess = make_shared<TinyProcessLib::Process>(CONVSTR(command), CONVSTR(options.cwd), stdOutHandler, stdErrHandler, true, processConfig);
     }
     else {
         TinyProcessLib::Process::environment_type processEnv;
         for(const auto& [key, value]: options.envs) {
             processEnv[CONVSTR(key)] = CONVSTR(value);
         }
-        childProcess = new TinyProcessLib::Process(CONVSTR(command), CONVSTR(options.cwd), processEnv, stdOutHandler, stdErrHandler, true);
+        childProcess = make_shared<TinyProcessLib::Process>(CONVSTR(command), CONVSTR(options.cwd), processEnv, stdOutHandler, stdErrHandler, true, processConfig);
     }
 
     spawnedProcesses[virtualPid] = childProcess;
 
-    thread processThread([=](){
-        int exitCode = childProcess->get_exit_status(); // sync wait
-        
+    auto exitHandler = [=](int exitCode) {
         if(options.events) {
-            __dispatchSpawnedProcessEvt(virtualPid, "exit", exitCode);
+            __closeProcessOutput(output);
+            __dispatchSpawnedProcessEvt(virtualPid, "exit", exitCode, options.connection);
         }
-        
-        lock_guard<mutex> guard(spawnedProcessesLock);
-        spawnedProcesses.erase(virtualPid);
-        delete childProcess;
-    });
-    processThread.detach();
+
+        {
+            lock_guard<mutex> guard(spawnedProcessesLock);
+            spawnedProcesses.erase(virtualPid);
+        }
+        if(options.exitHandler != nullptr) {
+            options.exitHandler(exitCode);
+        }
+    };
+
+    if(!useReactor || !processreactor::watch(childProcess, stdOutHandler, stdErrHandler, exitHandler)) {
+        childProcess->start_read_thread();
+        thread processThread([=](){
+            exitHandler(childProcess->get_exit_status()); // sync wait
+        });
+        processThread.detach();
+    }
 
     return make_pair(virtualPid, childProcess->get_id());
 }
 
 bool updateSpawnedProcess(const os::SpawnedProcessEvent &evt) {
-    if(spawnedProcesses.find(evt.id) == spawnedProcesses.end()) {
-        return false;
+    shared_ptr<TinyProcessLib::Process> childProcess;
+    {
+        // Writing to stdin may block, so the process list is not locked meanwhile
+        lock_guard<mutex> guard(spawnedProcessesLock);
+        auto it = spawnedProcesses.find(evt.id);
+        if(it == spawnedProcesses.end()) {
+            return false;
+        }
+        childProcess = it->second;
     }
 
-    TinyProcessLib::Process *childProcess = spawnedProcesses[evt.id];
-
     if(evt.type == "exit") {
         childProcess->kill();
     }
@@ -296,6 +587,22 @@ vector<string> __extensionsToVector(const json &filters) {
     return filtersV;
 }
 
+json __makeCommandOutput(const os::CommandResult &commandResult) {
+    json output;
+    json retVal;
+    retVal["pid"] = commandResult.pid;
+    retVal["exitCode"] = commandResult.exitCode;
+    retVal["stdOut"] = commandResult.stdOut;
+    retVal["stdErr"] = commandResult.stdErr;
+    retVal["stdOutTruncated"] = commandResult.stdOutTruncated;
+    retVal["stdErrTruncated"] = commandResult.stdErrTruncated;
+    retVal["timedOut"] = commandResult.timedOut;
+
+    output["returnValue"] = retVal;
+    output["success"] = true;
+    return output;
+}
+
 json execCommand(const json &input) {
     json output;
     if(!helpers::hasRequiredFields(input, {"command"})) {
@@ -321,16 +628,22 @@ json execCommand(const json &input) {
         }
     }
 
-    os::CommandResult commandResult = os::execCommand(command, processOptions);
-
-    json retVal;
-    retVal["pid"] = commandResult.pid;
-    retVal["exitCode"] = commandResult.exitCode;
-    retVal["stdOut"] = commandResult.stdOut;
-    retVal["stdErr"] = commandResult.stdErr;
+    if(helpers::hasField(input, "maxOutputBytes")) {
+        processOptions.maxOutputBytes = input["maxOutputBytes"].get<size_t>();
+    }
+    if(helpers::hasField(input, "timeout")) {
+        processOptions.timeout = input["timeout"].get<unsigned int>();
+    }
 
-    output["returnValue"] = retVal;
-    output["success"] = true;
+    // The response is sent when the process exits, so the call doesn't hold a worker thread
+    router::NativeCallPtr call = router::deferCurrentCall();
+    if(!call) {
+        return __makeCommandOutput(os::execCommand(command, processOptions));
+    }
+    function<void()> killCommand = os::execCommand(command, processOptions, [call](const os::CommandResult &commandResult) {
+        router::completeCall(call, __makeCommandOutput(commandResult));
+    });
+    router::setCancelHandler(call, killCommand);
     return output;
 }
 
@@ -355,6 +668,23 @@ json spawnProcess(const json &input) {
         }
     }
 
+    if(helpers::hasField(input, "outputMode")) {
+        string outputMode = input["outputMode"].get<string>();
+        if(outputMode == "line") {
+            processOptions.outputMode = os::OutputModeLine;
+        }
+        else if(outputMode == "coalesce") {
+            processOptions.outputMode = os::OutputModeCoalesce;
+        }
+    }
+    if(helpers::hasField(input, "outputInterval")) {
+        processOptions.outputInterval = input["outputInterval"].get<unsigned int>();
+    }
+    if(helpers::hasField(input, "binaryOutput")) {
+        processOptions.binaryOutput = input["binaryOutput"].get<bool>();
+    }
+    processOptions.connection = router::getCurrentConnection();
+
     auto spawnedData = os::spawnProcess(command, processOptions);
 
     json process;
@@ -407,6 +737,101 @@ json getSpawnedProcesses(const json &input) {
     return output;
 }
 
+json createProcessPool(const json &input) {
+    json output;
+    if(!helpers::hasRequiredFields(input, {"command"})) {
+        output["error"] = errors::makeMissingArgErrorPayload("command");
+        return output;
+    }
+    processpool::PoolOptions poolOptions;
+    poolOptions.command = input["command"].get<string>();
+    poolOptions.size = max(thread::hardware_concurrency(), 1u);
+
+    if(helpers::hasField(input, "size")) {
+        poolOptions.size = input["size"].get<unsigned int>();
+    }
+    if(helpers::hasField(input, "framing") && input["framing"].get<string>() == "length") {
+        poolOptions.framing = processpool::FramingLengthPrefix;
+    }
+    if(helpers::hasField(input, "cwd")) {
+        poolOptions.cwd = input["cwd"].get<string>();
+    }
+    if(helpers::hasField(input, "envs")) {
+        for(auto &[key, value]: input["envs"].items()) {
+            poolOptions.envs[key] = value.get<string>();
+        }
+    }
+
+    json pool;
+    pool["id"] = processpool::create(poolOptions);
+    pool["size"] = max(poolOptions.size, 1u);
+    output["returnValue"] = pool;
+    output["success"] = true;
+    return output;
+}
+
+json __makePoolResponse(const processpool::Response &response) {
+    json output;
+    if(response.code != errors::NE_ST_OK) {
+        output["error"] = errors::makeErrorPayload(response.code, response.data.get<string>());
+        return output;
+    }
+    output["returnValue"] = response.data;
+    output["success"] = true;
+    return output;
+}
+
+json callProcessPool(const json &input) {
+    json output;
+    const auto missingRequiredField = helpers::missingRequiredField(input, {"id", "data"});
+    if(missingRequiredField) {
+        output["error"] = errors::makeMissingArgErrorPayload(missingRequiredField.value());
+        return output;
+    }
+    int poolId = input["id"].get<int>();
+
+    // Like execCommand, the call is completed once a worker responds
+    router::NativeCallPtr call = router::deferCurrentCall();
+    auto responsePromise = make_shared<promise<json>>();
+    int requestId = processpool::call(poolId, input["data"], [call, responsePromise](const processpool::Response &response) {
+        if(call) {
+            router::completeCall(call, __makePoolResponse(response));
+        }
+        else {
+            responsePromise->set_value(__makePoolResponse(response));
+        }
+    });
+
+    // The router completes deferred calls that return an error
+    if(requestId < 0) {
+        output["error"] = errors::makeErrorPayload(errors::NE_OS_INVPOOL, to_string(poolId));
+        return output;
+    }
+    if(!call) {
+        return responsePromise->get_future().get(); // sync wait
+    }
+    router::setCancelHandler(call, [poolId, requestId]() {
+        processpool::cancel(poolId, requestId);
+    });
+    return output;
+}
+
+json destroyProcessPool(const json &input) {
+    json output;
+    if(!helpers::hasRequiredFields(input, {"id"})) {
+        output["error"] = errors::makeMissingArgErrorPayload("id");
+        return output;
+    }
+    int poolId = input["id"].get<int>();
+    if(processpool::destroy(poolId)) {
+        output["success"] = true;
+    }
+    else {
+        output["error"] = errors::makeErrorPayload(errors::NE_OS_INVPOOL, to_string(poolId));
+    }
+    return output;
+}
+
 json getEnv(const json &input) {
     json output;
     if(!helpers::hasRequiredFields(input, {"key"})) {
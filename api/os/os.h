@@ -4,6 +4,8 @@
 #include <string>
 #include <functional>
 
+#include <websocketpp/common/connection_hdl.hpp>
+
 #include "lib/json/json.hpp"
 
 using json = nlohmann::json;
@@ -16,28 +18,51 @@ struct CommandResult {
     int exitCode = -1;
     string stdErr = "";
     string stdOut = "";
+    bool stdErrTruncated = false;
+    bool stdOutTruncated = false;
+    bool timedOut = false;
 };
 
+typedef function<void(const os::CommandResult &)> CommandResultHandler;
+
 struct SpawnedProcessEvent {
     int id = -1;
     string type = "";
     string stdIn = "";
 };
 
+// How spawnProcess groups output chunks into spawnedProcess events
+enum OutputMode { OutputModeRaw, OutputModeLine, OutputModeCoalesce };
+
 struct ChildProcessOptions {
     bool background = false;
     bool events = true;
     string cwd = "";
     string stdIn = "";
     map<string, string> envs;
+    // Limits the captured output of execCommand, 0 means no limit
+    size_t maxOutputBytes = 0;
+    // Kills execCommand's process after this many milliseconds, 0 means no timeout
+    unsigned int timeout = 0;
+    // Sends spawnProcess's events only to this connection while it's open
+    websocketpp::connection_hdl connection;
+    os::OutputMode outputMode = os::OutputModeRaw;
+    // Coalescing window of OutputModeCoalesce in milliseconds
+    unsigned int outputInterval = 16;
+    // Sends output chunks as binary values instead of strings
+    bool binaryOutput = false;
     function<void(const char *bytes, size_t n)> stdOutHandler;
     function<void(const char *bytes, size_t n)> stdErrHandler;
+    // Called after spawnProcess's process exits and leaves the process list
+    function<void(int exitCode)> exitHandler;
 };
 
 bool isTrayInitialized();
 void cleanupTray();
 void open(const string &url);
 os::CommandResult execCommand(string command, const os::ChildProcessOptions &options = {});
+function<void()> execCommand(string command, const os::ChildProcessOptions &options,
+    const os::CommandResultHandler &resultHandler);
 pair<int, int> spawnProcess(string command, const os::ChildProcessOptions &options = {});
 bool updateSpawnedProcess(const os::SpawnedProcessEvent &evt);
 string getPath(const string &name);
@@ -49,6 +74,9 @@ json execCommand(const json &input);
 json spawnProcess(const json &input);
 json updateSpawnedProcess(const json &input);
 json getSpawnedProcesses(const json &input);
+json createProcessPool(const json &input);
+json callProcessPool(const json &input);
+json destroyProcessPool(const json &input);
 json getEnv(const json &input);
 json getEnvs(const json &input);
 json showOpenDialog(const json &input);
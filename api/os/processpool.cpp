@@ -0,0 +1,453 @@
+#include <string>
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <algorithm>
+
+#include <asio/thread_pool.hpp>
+#include <asio/post.hpp>
+
+#include "lib/json/json.hpp"
+#include "helpers.h"
+#include "errors.h"
+#include "scheduler.h"
+#include "api/os/os.h"
+#include "api/os/processpool.h"
+
+#define NEU_PROCESS_POOL_RESTART_WINDOW 1000
+#define NEU_PROCESS_POOL_RESTART_DELAY 1000
+#define NEU_PROCESS_POOL_WRITER_THREADS 4
+#define NEU_PROCESS_POOL_MAX_FRAME_SIZE 67108864
+
+using namespace std;
+using json = nlohmann::json;
+
+/*
+* Keeps warm worker processes that read requests from stdin and write one
+* response per request to stdout. Each worker handles one request at a time,
+* so a response always belongs to the request its worker is busy with.
+* Dead workers are restarted, after a delay if they die right after starting.
+*/
+
+namespace processpool {
+
+struct Request {
+    int id = -1;
+    string frame;
+    processpool::ResponseHandler responseHandler;
+};
+
+typedef shared_ptr<processpool::Request> RequestPtr;
+
+struct Worker {
+    int virtualPid = -1;
+    // Set once spawnProcess returns the virtual pid
+    bool started = false;
+    bool exited = false;
+    // Killed to cancel its request, so it doesn't get new ones
+    bool stopping = false;
+    processpool::RequestPtr request;
+    string output;
+    chrono::steady_clock::time_point startTime;
+};
+
+typedef shared_ptr<processpool::Worker> WorkerPtr;
+
+struct Pool {
+    processpool::PoolOptions options;
+    mutex lock;
+    vector<processpool::WorkerPtr> workers;
+    deque<processpool::RequestPtr> pendingRequests;
+    bool destroyed = false;
+};
+
+typedef shared_ptr<processpool::Pool> PoolPtr;
+
+map<int, processpool::PoolPtr> pools;
+mutex poolsLock;
+atomic<int> nextPoolId(0);
+atomic<int> nextRequestId(0);
+// Requests are written to the workers' stdin from these threads. Responses are
+// read on the process reactor thread, and a worker that writes output before
+// it reads the whole request would block a write there and its own output.
+asio::thread_pool *requestWriters = nullptr;
+once_flag requestWritersFlag;
+
+int __nextId(atomic<int> &nextId) {
+    int id = nextId++;
+    if(id == INT_MAX) {
+        nextId = 0;
+    }
+    return id;
+}
+
+processpool::PoolPtr __findPool(int poolId) {
+    lock_guard<mutex> guard(poolsLock);
+    auto it = pools.find(poolId);
+    return it != pools.end() ? it->second : nullptr;
+}
+
+string __makeFrame(processpool::Framing framing, const json &data) {
+    if(framing == processpool::FramingJsonLines) {
+        // Serialized JSON never has raw newlines
+        return data.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+    }
+    // Binary values are sent as is, strings as their UTF-8 bytes
+    string bytes;
+    if(data.is_binary()) {
+        bytes = helpers::jsonToBinary(data);
+    }
+    else if(data.is_string()) {
+        bytes = data.get<string>();
+    }
+    else {
+        bytes = data.dump(-1, ' ', false, json::error_handler_t::replace);
+    }
+    uint32_t size = bytes.size();
+    string frame = {
+        (char) (size >> 24), (char) (size >> 16), (char) (size >> 8), (char) size
+    };
+    return frame + bytes;
+}
+
+size_t __readFrameSize(const string &output, size_t offset) {
+    const unsigned char *header = (const unsigned char *) output.data() + offset;
+    return ((size_t) header[0] << 24) | ((size_t) header[1] << 16) | ((size_t) header[2] << 8) | header[3];
+}
+
+// Reads a frame that starts at offset. Returns the offset after the frame,
+// or string::npos if the frame is not complete yet.
+size_t __readFrame(processpool::Framing framing, const string &output, size_t offset, json &data) {
+    if(framing == processpool::FramingJsonLines) {
+        size_t lineEnd = output.find('\n', offset);
+        if(lineEnd == string::npos) {
+            return string::npos;
+        }
+        size_t length = lineEnd - offset;
+        if(length > 0 && output[lineEnd - 1] == '\r') {
+            length--;
+        }
+        string line = output.substr(offset, length);
+        data = json::parse(line, nullptr, false);
+        // Plain text responses are passed as strings
+        if(data.is_discarded()) {
+            data = line;
+        }
+        return lineEnd + 1;
+    }
+    if(output.size() - offset < 4) {
+        return string::npos;
+    }
+    size_t size = __readFrameSize(output, offset);
+    if(output.size() - offset - 4 < size) {
+        return string::npos;
+    }
+    data = helpers::binaryToJson(output.substr(offset + 4, size));
+    return offset + 4 + size;
+}
+
+// Checks the incomplete frame at offset, so a worker that writes a huge length
+// prefix or a line without an end doesn't make the pool buffer its output forever
+bool __isFrameTooLarge(processpool::Framing framing, const string &output, size_t offset) {
+    if(framing == processpool::FramingJsonLines) {
+        return output.size() - offset > NEU_PROCESS_POOL_MAX_FRAME_SIZE;
+    }
+    return output.size() - offset >= 4 && __readFrameSize(output, offset) > NEU_PROCESS_POOL_MAX_FRAME_SIZE;
+}
+
+// Writes a request on a writer thread. The thread pool is never destroyed, so
+// exiting the app doesn't wait for a write to a worker that doesn't read its stdin.
+void __writeRequest(int virtualPid, string &&frame) {
+    call_once(requestWritersFlag, []() {
+        requestWriters = new asio::thread_pool(NEU_PROCESS_POOL_WRITER_THREADS);
+    });
+    asio::post(*requestWriters, [virtualPid, frame = move(frame)]() mutable {
+        // If the worker is gone already, its exit handler fails the request
+        os::SpawnedProcessEvent processEvt;
+        processEvt.id = virtualPid;
+        processEvt.type = "stdIn";
+        processEvt.stdIn = move(frame);
+        os::updateSpawnedProcess(processEvt);
+    });
+}
+
+// Hands pending requests to idle workers. Requests are written outside the
+// pool lock since a worker that doesn't read its stdin blocks the write.
+void __dispatch(const processpool::PoolPtr &pool) {
+    vector<pair<int, string>> frames;
+    {
+        lock_guard<mutex> guard(pool->lock);
+        for(const processpool::WorkerPtr &worker: pool->workers) {
+            if(pool->pendingRequests.empty()) {
+                break;
+            }
+            if(!worker->started || worker->exited || worker->stopping || worker->request) {
+                continue;
+            }
+            worker->request = pool->pendingRequests.front();
+            pool->pendingRequests.pop_front();
+            frames.push_back({worker->virtualPid, move(worker->request->frame)});
+        }
+    }
+    for(auto &[virtualPid, frame]: frames) {
+        __writeRequest(virtualPid, move(frame));
+    }
+}
+
+void __stopWorkers(const vector<int> &virtualPids) {
+    for(int virtualPid: virtualPids) {
+        os::SpawnedProcessEvent processEvt;
+        processEvt.id = virtualPid;
+        processEvt.type = "exit";
+        os::updateSpawnedProcess(processEvt);
+    }
+}
+
+void __readResponses(const processpool::PoolPtr &pool, const processpool::WorkerPtr &worker,
+    const char *bytes, size_t n) {
+    vector<pair<processpool::RequestPtr, json>> responses;
+    processpool::RequestPtr failedRequest;
+    int stoppedVirtualPid = -1;
+    {
+        lock_guard<mutex> guard(pool->lock);
+        // Output of a worker that is being stopped doesn't belong to any request
+        if(worker->stopping) {
+            return;
+        }
+        worker->output.append(bytes, n);
+        size_t offset = 0;
+        json data;
+        for(size_t frameEnd; (frameEnd = __readFrame(pool->options.framing, worker->output, offset, data)) !=
+            string::npos; offset = frameEnd) {
+            // Output without a request (i.e., of a cancelled one) is dropped
+            if(worker->request) {
+                responses.push_back({move(worker->request), move(data)});
+                worker->request = nullptr;
+            }
+        }
+        worker->output.erase(0, offset);
+        // The rest of the output can't be framed anymore, so the worker is restarted
+        if(__isFrameTooLarge(pool->options.framing, worker->output, 0)) {
+            worker->output.clear();
+            worker->stopping = true;
+            failedRequest = move(worker->request);
+            worker->request = nullptr;
+            stoppedVirtualPid = worker->virtualPid;
+        }
+    }
+    for(auto &[request, data]: responses) {
+        processpool::Response response;
+        response.data = move(data);
+        request->responseHandler(response);
+    }
+    if(stoppedVirtualPid >= 0) {
+        __stopWorkers({stoppedVirtualPid});
+    }
+    if(failedRequest) {
+        processpool::Response response;
+        response.code = errors::NE_OS_PRWKFRM;
+        response.data = to_string(NEU_PROCESS_POOL_MAX_FRAME_SIZE);
+        failedRequest->responseHandler(response);
+    }
+    if(!responses.empty()) {
+        __dispatch(pool);
+    }
+}
+
+void __handleWorkerExit(const processpool::PoolPtr &pool, const processpool::WorkerPtr &worker, int exitCode);
+
+void __startWorker(const processpool::PoolPtr &pool, const processpool::WorkerPtr &worker) {
+    {
+        lock_guard<mutex> guard(pool->lock);
+        if(pool->destroyed) {
+            return;
+        }
+        worker->startTime = chrono::steady_clock::now();
+    }
+
+    os::ChildProcessOptions processOptions;
+    processOptions.events = false;
+    processOptions.cwd = pool->options.cwd;
+    processOptions.envs = pool->options.envs;
+    processOptions.stdOutHandler = [pool, worker](const char *bytes, size_t n) {
+        __readResponses(pool, worker, bytes, n);
+    };
+    processOptions.exitHandler = [pool, worker](int exitCode) {
+        __handleWorkerExit(pool, worker, exitCode);
+    };
+
+    int virtualPid = os::spawnProcess(pool->options.command, processOptions).first;
+    bool destroyed;
+    {
+        lock_guard<mutex> guard(pool->lock);
+        worker->virtualPid = virtualPid;
+        worker->started = true;
+        destroyed = pool->destroyed;
+    }
+    // The pool may get destroyed while the worker starts
+    if(destroyed) {
+        __stopWorkers({virtualPid});
+        return;
+    }
+    __dispatch(pool);
+}
+
+void __handleWorkerExit(const processpool::PoolPtr &pool, const processpool::WorkerPtr &worker, int exitCode) {
+    processpool::RequestPtr request;
+    processpool::WorkerPtr newWorker;
+    bool delayRestart;
+    {
+        lock_guard<mutex> guard(pool->lock);
+        worker->exited = true;
+        request = move(worker->request);
+        worker->request = nullptr;
+        if(!pool->destroyed) {
+            newWorker = make_shared<processpool::Worker>();
+            replace(pool->workers.begin(), pool->workers.end(), worker, newWorker);
+        }
+        // Workers that fail on startup (i.e., a wrong command) are not restarted in a busy loop
+        auto uptime = chrono::steady_clock::now() - worker->startTime;
+        delayRestart = !worker->stopping && uptime < chrono::milliseconds(NEU_PROCESS_POOL_RESTART_WINDOW);
+    }
+    if(request) {
+        processpool::Response response;
+        response.code = errors::NE_OS_PRWKEXT;
+        response.data = to_string(exitCode);
+        request->responseHandler(response);
+    }
+    if(!newWorker) {
+        return;
+    }
+    if(delayRestart && scheduler::getIoContext()) {
+        scheduler::setTimeout([pool, newWorker]() {
+            __startWorker(pool, newWorker);
+        }, chrono::milliseconds(NEU_PROCESS_POOL_RESTART_DELAY));
+    }
+    else {
+        __startWorker(pool, newWorker);
+    }
+}
+
+// Starts the pool's workers and returns the pool id
+int create(const processpool::PoolOptions &options) {
+    processpool::PoolPtr pool = make_shared<processpool::Pool>();
+    pool->options = options;
+    pool->options.size = max(options.size, 1u);
+    for(unsigned int i = 0; i < pool->options.size; i++) {
+        pool->workers.push_back(make_shared<processpool::Worker>());
+    }
+
+    int poolId = __nextId(nextPoolId);
+    {
+        lock_guard<mutex> guard(poolsLock);
+        pools[poolId] = pool;
+    }
+    vector<processpool::WorkerPtr> workers = pool->workers;
+    for(const processpool::WorkerPtr &worker: workers) {
+        __startWorker(pool, worker);
+    }
+    return poolId;
+}
+
+// Queues a request for the next idle worker. The response handler gets called
+// from the thread that reads the worker output. Returns the request id, or -1
+// if the pool doesn't exist.
+int call(int poolId, const json &data, const processpool::ResponseHandler &responseHandler) {
+    processpool::PoolPtr pool = __findPool(poolId);
+    if(!pool) {
+        return -1;
+    }
+    processpool::RequestPtr request = make_shared<processpool::Request>();
+    request->id = __nextId(nextRequestId);
+    request->frame = __makeFrame(pool->options.framing, data);
+    request->responseHandler = responseHandler;
+    {
+        lock_guard<mutex> guard(pool->lock);
+        if(pool->destroyed) {
+            return -1;
+        }
+        pool->pendingRequests.push_back(request);
+    }
+    __dispatch(pool);
+    return request->id;
+}
+
+// Drops the request without calling its response handler. A worker that is
+// busy with the request is restarted since it may be in the middle of it.
+bool cancel(int poolId, int requestId) {
+    processpool::PoolPtr pool = __findPool(poolId);
+    if(!pool) {
+        return false;
+    }
+    int virtualPid = -1;
+    {
+        lock_guard<mutex> guard(pool->lock);
+        for(auto it = pool->pendingRequests.begin(); it != pool->pendingRequests.end(); ++it) {
+            if((*it)->id == requestId) {
+                pool->pendingRequests.erase(it);
+                return true;
+            }
+        }
+        for(const processpool::WorkerPtr &worker: pool->workers) {
+            if(worker->request && worker->request->id == requestId) {
+                worker->request = nullptr;
+                worker->stopping = true;
+                virtualPid = worker->virtualPid;
+                break;
+            }
+        }
+    }
+    if(virtualPid < 0) {
+        return false;
+    }
+    __stopWorkers({virtualPid});
+    return true;
+}
+
+// Stops the workers and fails the requests that didn't get a response yet
+bool destroy(int poolId) {
+    processpool::PoolPtr pool;
+    {
+        lock_guard<mutex> guard(poolsLock);
+        auto it = pools.find(poolId);
+        if(it == pools.end()) {
+            return false;
+        }
+        pool = it->second;
+        pools.erase(it);
+    }
+    vector<processpool::RequestPtr> requests;
+    vector<int> virtualPids;
+    {
+        lock_guard<mutex> guard(pool->lock);
+        pool->destroyed = true;
+        requests.assign(pool->pendingRequests.begin(), pool->pendingRequests.end());
+        pool->pendingRequests.clear();
+        for(const processpool::WorkerPtr &worker: pool->workers) {
+            if(worker->request) {
+                requests.push_back(move(worker->request));
+                worker->request = nullptr;
+            }
+            if(worker->started && !worker->exited) {
+                worker->stopping = true;
+                virtualPids.push_back(worker->virtualPid);
+            }
+        }
+    }
+    __stopWorkers(virtualPids);
+    for(const processpool::RequestPtr &request: requests) {
+        processpool::Response response;
+        response.code = errors::NE_OS_INVPOOL;
+        response.data = to_string(poolId);
+        request->responseHandler(response);
+    }
+    return true;
+}
+
+} // namespace processpool
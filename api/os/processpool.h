@@ -0,0 +1,44 @@
+#ifndef NEU_PROCESSPOOL_H
+#define NEU_PROCESSPOOL_H
+
+#include <string>
+#include <map>
+#include <functional>
+
+#include "lib/json/json.hpp"
+#include "errors.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+namespace processpool {
+
+// How requests and responses are framed on the workers' stdin and stdout.
+// FramingJsonLines sends one JSON document per line, FramingLengthPrefix sends
+// raw bytes after a 4-byte big-endian length.
+enum Framing { FramingJsonLines, FramingLengthPrefix };
+
+struct PoolOptions {
+    string command = "";
+    string cwd = "";
+    map<string, string> envs;
+    unsigned int size = 1;
+    processpool::Framing framing = processpool::FramingJsonLines;
+};
+
+// The response of a request. On errors, data holds the error message parameter.
+struct Response {
+    errors::StatusCode code = errors::NE_ST_OK;
+    json data;
+};
+
+typedef function<void(const processpool::Response &)> ResponseHandler;
+
+int create(const processpool::PoolOptions &options);
+int call(int poolId, const json &data, const processpool::ResponseHandler &responseHandler);
+bool cancel(int poolId, int requestId);
+bool destroy(int poolId);
+
+} // namespace processpool
+
+#endif // #define NEU_PROCESSPOOL_H
@@ -0,0 +1,298 @@
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <list>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include "lib/tinyprocess/process.hpp"
+#include "api/os/processreactor.h"
+
+#define NEU_PROCESS_REACTOR_MAX_EVENTS 64
+#define NEU_PROCESS_REACTOR_BUFFER_SIZE 131072
+#define NEU_PROCESS_REACTOR_POLL_INTERVAL 100
+
+using namespace std;
+
+/*
+* Reads the output of all spawned processes and waits for their exits on one
+* epoll loop instead of two threads per process. Exits are watched with pidfds
+* (Linux 5.3+). Older kernels poll the exit status once the output pipes close.
+*/
+
+namespace processreactor {
+
+#if defined(__linux__)
+
+enum SourceType { SourceTypeStdOut, SourceTypeStdErr, SourceTypeExit, SourceTypeWake };
+
+struct WatchedProcess;
+
+struct Source {
+    processreactor::WatchedProcess *watched = nullptr;
+    processreactor::SourceType type;
+    int fd = -1;
+};
+
+struct WatchedProcess {
+    shared_ptr<TinyProcessLib::Process> process;
+    processreactor::Source stdOut;
+    processreactor::Source stdErr;
+    processreactor::Source exit;
+    processreactor::OutputHandler stdOutHandler;
+    processreactor::OutputHandler stdErrHandler;
+    processreactor::ExitHandler exitHandler;
+    bool exited = false;
+    bool finished = false;
+};
+
+int epollFd = -1;
+processreactor::Source wakeSource;
+// New processes are registered on the reactor thread, so watched processes
+// are only touched there
+vector<processreactor::WatchedProcess *> pendingProcesses;
+mutex pendingProcessesLock;
+list<processreactor::WatchedProcess *> polledProcesses;
+thread_local bool reactorThread = false;
+
+int __openPidFd(pid_t pid) {
+    #if defined(SYS_pidfd_open)
+    return syscall(SYS_pidfd_open, pid, 0);
+    #else
+    errno = ENOSYS;
+    return -1;
+    #endif
+}
+
+bool __addSource(processreactor::Source &source) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = &source;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, source.fd, &event) == 0;
+}
+
+void __removeSource(processreactor::Source &source) {
+    if(source.fd < 0) {
+        return;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, source.fd, nullptr);
+    // Pipes belong to the process object, it closes them after reaping
+    if(source.type == processreactor::SourceTypeExit) {
+        close(source.fd);
+    }
+    source.fd = -1;
+}
+
+// Checks for the exit without reaping, so the process object can still reap it
+bool __hasExited(pid_t pid) {
+    siginfo_t info = {};
+    return waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid;
+}
+
+void __register(processreactor::WatchedProcess *watched) {
+    for(processreactor::Source *source: {&watched->stdOut, &watched->stdErr}) {
+        if(source->fd < 0) {
+            continue;
+        }
+        fcntl(source->fd, F_SETFL, fcntl(source->fd, F_GETFL) | O_NONBLOCK);
+        if(!__addSource(*source)) {
+            source->fd = -1;
+        }
+    }
+    if(watched->exit.fd >= 0 && !__addSource(watched->exit)) {
+        close(watched->exit.fd);
+        watched->exit.fd = -1;
+    }
+}
+
+void __read(processreactor::Source &source, char *buffer) {
+    ssize_t n = read(source.fd, buffer, NEU_PROCESS_REACTOR_BUFFER_SIZE);
+    if(n > 0) {
+        processreactor::WatchedProcess *watched = source.watched;
+        if(source.type == processreactor::SourceTypeStdOut) {
+            watched->stdOutHandler(buffer, n);
+        }
+        else {
+            watched->stdErrHandler(buffer, n);
+        }
+        return;
+    }
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    __removeSource(source);
+}
+
+// A process is finished once it exited and its output pipes are drained,
+// so the exit handler always runs after the last output chunk
+bool __isFinished(processreactor::WatchedProcess *watched) {
+    if(watched->finished || watched->stdOut.fd >= 0 || watched->stdErr.fd >= 0) {
+        return false;
+    }
+    if(watched->exited) {
+        return true;
+    }
+    if(watched->exit.fd < 0 && __hasExited(watched->process->get_id())) {
+        return true;
+    }
+    if(watched->exit.fd < 0 && find(polledProcesses.begin(), polledProcesses.end(), watched) ==
+        polledProcesses.end()) {
+        polledProcesses.push_back(watched);
+    }
+    return false;
+}
+
+void __finish(processreactor::WatchedProcess *watched) {
+    // Returns immediately since the process already exited
+    int exitCode = watched->process->get_exit_status();
+    watched->exitHandler(exitCode);
+    delete watched;
+}
+
+void __run() {
+    reactorThread = true;
+    epoll_event events[NEU_PROCESS_REACTOR_MAX_EVENTS];
+    auto buffer = unique_ptr<char[]>(new char[NEU_PROCESS_REACTOR_BUFFER_SIZE]);
+    while(true) {
+        int timeout = polledProcesses.empty() ? -1 : NEU_PROCESS_REACTOR_POLL_INTERVAL;
+        int count = epoll_wait(epollFd, events, NEU_PROCESS_REACTOR_MAX_EVENTS, timeout);
+        if(count < 0 && errno != EINTR) {
+            return;
+        }
+        vector<processreactor::WatchedProcess *> finishedProcesses;
+        for(int i = 0; i < count; i++) {
+            processreactor::Source *source = (processreactor::Source *) events[i].data.ptr;
+            if(source->type == processreactor::SourceTypeWake) {
+                eventfd_t value;
+                eventfd_read(source->fd, &value);
+                vector<processreactor::WatchedProcess *> newProcesses;
+                {
+                    lock_guard<mutex> guard(pendingProcessesLock);
+                    newProcesses.swap(pendingProcesses);
+                }
+                for(processreactor::WatchedProcess *watched: newProcesses) {
+                    __register(watched);
+                    if(__isFinished(watched)) {
+                        watched->finished = true;
+                        finishedProcesses.push_back(watched);
+                    }
+                }
+                continue;
+            }
+            // Another event of this batch may have removed the source
+            if(source->fd < 0) {
+                continue;
+            }
+            processreactor::WatchedProcess *watched = source->watched;
+            if(source->type == processreactor::SourceTypeExit) {
+                watched->exited = true;
+                __removeSource(*source);
+            }
+            else {
+                __read(*source, buffer.get());
+            }
+            if(__isFinished(watched)) {
+                watched->finished = true;
+                finishedProcesses.push_back(watched);
+            }
+        }
+        for(auto it = polledProcesses.begin(); it != polledProcesses.end();) {
+            if(__hasExited((*it)->process->get_id())) {
+                (*it)->finished = true;
+                finishedProcesses.push_back(*it);
+                it = polledProcesses.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        for(processreactor::WatchedProcess *watched: finishedProcesses) {
+            __finish(watched);
+        }
+    }
+}
+
+bool __init() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFd < 0) {
+        return false;
+    }
+    wakeSource.type = processreactor::SourceTypeWake;
+    wakeSource.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(wakeSource.fd < 0 || !__addSource(wakeSource)) {
+        close(epollFd);
+        epollFd = -1;
+        return false;
+    }
+    thread reactorThread(__run);
+    reactorThread.detach();
+    return true;
+}
+
+#endif
+
+// Starts the reactor thread on first use. Returns false if this platform
+// reads process output with TinyProcessLib's threads instead.
+bool init() {
+    #if defined(__linux__)
+    static once_flag initFlag;
+    static bool initialized = false;
+    call_once(initFlag, []() {
+        initialized = __init();
+    });
+    return initialized;
+    #else
+    return false;
+    #endif
+}
+
+// Output and exit handlers of all processes run on the reactor thread, so
+// they shouldn't block (i.e., wait for a slow WebSocket client)
+bool isReactorThread() {
+    #if defined(__linux__)
+    return reactorThread;
+    #else
+    return false;
+    #endif
+}
+
+// Reads the process output and calls the exit handler after the process exits
+// and its output pipes are closed. The process should be created with
+// read_in_thread = false.
+bool watch(const shared_ptr<TinyProcessLib::Process> &process, const processreactor::OutputHandler &stdOutHandler,
+    const processreactor::OutputHandler &stdErrHandler, const processreactor::ExitHandler &exitHandler) {
+    #if defined(__linux__)
+    if(epollFd < 0 || process->get_id() <= 0) {
+        return false;
+    }
+    processreactor::WatchedProcess *watched = new processreactor::WatchedProcess();
+    watched->process = process;
+    watched->stdOut = {watched, processreactor::SourceTypeStdOut, process->get_stdout_fd()};
+    watched->stdErr = {watched, processreactor::SourceTypeStdErr, process->get_stderr_fd()};
+    watched->exit = {watched, processreactor::SourceTypeExit, __openPidFd(process->get_id())};
+    watched->stdOutHandler = stdOutHandler;
+    watched->stdErrHandler = stdErrHandler;
+    watched->exitHandler = exitHandler;
+    {
+        lock_guard<mutex> guard(pendingProcessesLock);
+        pendingProcesses.push_back(watched);
+    }
+    eventfd_write(wakeSource.fd, 1);
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+} // namespace processreactor
@@ -0,0 +1,23 @@
+#ifndef NEU_PROCESSREACTOR_H
+#define NEU_PROCESSREACTOR_H
+
+#include <memory>
+#include <functional>
+
+#include "lib/tinyprocess/process.hpp"
+
+using namespace std;
+
+namespace processreactor {
+
+typedef function<void(const char *bytes, size_t n)> OutputHandler;
+typedef function<void(int exitCode)> ExitHandler;
+
+bool init();
+bool isReactorThread();
+bool watch(const shared_ptr<TinyProcessLib::Process> &process, const processreactor::OutputHandler &stdOutHandler,
+    const processreactor::OutputHandler &stdErrHandler, const processreactor::ExitHandler &exitHandler);
+
+} // namespace processreactor
+
+#endif // #define NEU_PROCESSREACTOR_H
@@ -11,8 +11,9 @@
 
 #include "api/res/res.h"
 #include "api/fs/fs.h"
+#include "api/events/events.h"
+#include "server/router.h"
 
-#include "lib/base64/base64.hpp"
 
 using namespace std;
 using json = nlohmann::json;
@@ -20,68 +21,6 @@ using json = nlohmann::json;
 namespace res {
 namespace controllers {
 
-vector<string> __getAllFiles() {
-    vector<string> files = {};
-    std::function<void(const string &, const json &)> parseBundleHeader;
-    parseBundleHeader = [&](const string &basePath, const json &data) {
-        if(!helpers::hasField(data, "files")) {
-            return;
-        }
-
-        for(auto &[childPath, childData]: data["files"].items()) {
-            string path = basePath + "/" + childPath;
-            files.push_back(path);  
-            parseBundleHeader(path, childData);
-        }
-    };
-
-    parseBundleHeader("", resources::getFileTree());
-    return files;
-}
-
-vector<string> __getFiles(const string &rootPath) {
-    vector<string> files = {};
-    std::function<void(const string &, const json &)> parseBundleHeader;
-    parseBundleHeader = [&](const string &path, const json &data) {    
-        if(!helpers::hasField(data, "files")) {
-            if(path.rfind(rootPath, 0) != string::npos) {
-                files.push_back(path);
-            }
-            return;
-        }
-        else if(rootPath.rfind(path, 0) == string::npos && path.rfind(rootPath, 0) == string::npos) {
-            return;
-        }
-
-        for(auto &[childPath, childData]: data["files"].items()) {
-            parseBundleHeader(path + "/" + childPath, childData);
-        }
-    };
-
-    parseBundleHeader("", resources::getFileTree());
-    return files;
-}
-
-pair<unsigned long, bool> __getStats(const string &path) {
-    vector<string> pathSegments = helpers::split(path, '/');
-    json json = resources::getFileTree();
-    for(const auto &pathSegment: pathSegments) {
-        if(pathSegment.size() == 0) {
-            continue;
-        }
-        if(json.is_null()) {
-            break;
-        }
-        json = json["files"][pathSegment];
-    }
-    if(!json.is_null()) {
-        bool isFile = json["files"].is_null();
-        return make_pair(
-            isFile ? json["size"].get<unsigned long>() : 4096, isFile);
-    }
-    return make_pair(-1, false);
-}
-
 string __getResourcesDirectory() {
     json options = settings::getConfig();
     json jResourcesPath = options["cli"]["resourcesPath"];
@@ -104,7 +43,9 @@ json getFiles(const json &input) {
     json output;
     json files = json::array();
     if(resources::isBundleMode() || resources::isEmbeddedMode()) {
-        files = __getAllFiles();
+        for(const resources::ResourceEntry *entry: resources::getEntries("/")) {
+            files.push_back(entry->path);
+        }
     }
     else {
         string resourcesPath = __getResourcesDirectory(); 
@@ -131,12 +72,12 @@ json getStats(const json &input) {
     }
     string path = input["path"].get<string>();
     if(resources::isBundleMode() || resources::isEmbeddedMode()) {
-        auto resStats = __getStats(path);
-        if(resStats.first != -1) {
+        const resources::ResourceEntry *entry = resources::getEntry(path);
+        if(entry) {
             json stats;
-            stats["size"] = resStats.first;
-            stats["isFile"] = resStats.second;
-            stats["isDirectory"] = !resStats.second;
+            stats["size"] = entry->isDirectory ? 4096 : entry->size;
+            stats["isFile"] = !entry->isDirectory;
+            stats["isDirectory"] = entry->isDirectory;
             
             output["returnValue"] = stats;
             output["success"] = true;
@@ -213,15 +154,30 @@ json extractDirectory(const json &input) {
     string destination = input["destination"].get<string>();
 
     if(resources::isBundleMode() || resources::isEmbeddedMode()) {
-        auto resPaths = __getFiles(path);
-        for(const auto &resPath: resPaths) {
-            string extractPath = resPath;
-            extractPath = helpers::normalizePath(extractPath)
-                                .substr(path == "/" ? 1 : path.size() + 1);
-            resources::extractFile(resPath, FS_CONVWSTR(filesystem::path(CONVSTR(destination)) / 
-                filesystem::path(CONVSTR(extractPath))));
+        const resources::ResourceEntry *dirEntry = resources::getEntry(path);
+        if(!dirEntry || !dirEntry->isDirectory) {
+            output["error"] = errors::makeErrorPayload(errors::NE_RS_NOPATHE, path);
+            return output;
+        }
+        websocketpp::connection_hdl connection = router::getCurrentConnection();
+        auto dispatchProgress = [&](const resources::ExtractionProgress &progress) {
+            json evt;
+            evt["path"] = path;
+            evt["destination"] = destination;
+            evt["files"] = progress.files;
+            evt["totalFiles"] = progress.totalFiles;
+            evt["bytes"] = progress.bytes;
+            evt["totalBytes"] = progress.totalBytes;
+            if(connection.expired() || !events::dispatchToConnection(connection, "extractDirectoryProgress", evt)) {
+                events::dispatch("extractDirectoryProgress", evt);
+            }
+        };
+        if(resources::extractDirectory(path, destination, dispatchProgress)) {
+            output["success"] = true;
+        }
+        else {
+            output["error"] = errors::makeErrorPayload(errors::NE_RS_DIREXTF, destination);
         }
-        output["success"] = true;
     }
     else if(resources::isDirMode()) {
         path = settings::joinAppPath(path);
@@ -276,7 +232,7 @@ json readBinaryFile(const json &input) {
         output["error"] = errors::makeErrorPayload(fileReaderResult.status, path);
     }
     else {
-        output["returnValue"] = base64::to_base64(fileReaderResult.data);
+        output["returnValue"] = helpers::binaryToJson(fileReaderResult.data);
         output["success"] = true;
     }
     return output;
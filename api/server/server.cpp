@@ -5,6 +5,7 @@
 #include "helpers.h"
 #include "errors.h"
 #include "server/router.h"
+#include "server/neuserver.h"
 #include "api/server/server.h"
 
 using namespace std;
@@ -56,5 +57,12 @@ json getMounts(const json &input) {
     return output;
 }
 
+json getConnectionStats(const json &input) {
+    json output;
+    output["returnValue"] = neuserver::getConnectionStats();
+    output["success"] = true;
+    return output;
+}
+
 } // namespace controllers
 } // namespace server
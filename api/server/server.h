@@ -14,6 +14,7 @@ namespace controllers {
 json mount(const json &input);
 json unmount(const json &input);
 json getMounts(const json &input);
+json getConnectionStats(const json &input);
 
 
 } // namespace controllers
@@ -47,6 +47,7 @@
 #include "helpers.h"
 #include "errors.h"
 #include "server/neuserver.h"
+#include "server/router.h"
 #include "auth/permission.h"
 #include "api/app/app.h"
 #include "api/window/window.h"
@@ -602,6 +603,8 @@ void __injectScript() {
 
 bool __createWindow() {
     savedState = windowProps.useSavedState && __loadSavedWindowProps();
+    // Startup assets are read while the webview starts
+    router::prefetchAssets();
 
     nativeWindow = new webview::webview(windowProps.enableInspector, windowProps.openInspectorOnStartup, 
         nullptr, windowProps.transparent, windowProps.webviewArgs);
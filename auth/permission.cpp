@@ -3,7 +3,6 @@
 #include <chrono>
 #include <thread>
 #include <vector>
-#include <regex>
 #include <algorithm>
 
 #include "lib/json/json.hpp"
@@ -23,7 +22,7 @@ bool shouldCheckBlockList = false;
 bool shouldCheckAllowList = false;
 
 bool __isWildcardMatch(const string &methodMatch) {
-    return regex_match(methodMatch, regex(".*\\.\\*"));
+    return helpers::endsWith(methodMatch, ".*");
 }
 
 string __getModuleFromMethod(const string &nativeMethod) {
@@ -25,6 +25,9 @@ string __getStatusCodeString(const errors::StatusCode code) {
         case errors::NE_OS_INVMSGA: return "NE_OS_INVMSGA";
         case errors::NE_OS_TRAYIER: return "NE_OS_TRAYIER";
         case errors::NE_OS_INVKNPT: return "NE_OS_INVKNPT";
+        case errors::NE_OS_INVPOOL: return "NE_OS_INVPOOL";
+        case errors::NE_OS_PRWKEXT: return "NE_OS_PRWKEXT";
+        case errors::NE_OS_PRWKFRM: return "NE_OS_PRWKFRM";
         // computer
         case errors::NE_CO_UNLTOSC: return "NE_CO_UNLTOSC";
         case errors::NE_CO_UNLTOMG: return "NE_CO_UNLTOMG";
@@ -53,6 +56,8 @@ string __getStatusCodeString(const errors::StatusCode code) {
         case errors::NE_RT_NATPRME: return "NE_RT_NATPRME";
         case errors::NE_RT_NATRTER: return "NE_RT_NATRTER";
         case errors::NE_RT_NATNTIM: return "NE_RT_NATNTIM";
+        case errors::NE_RT_NATCNCL: return "NE_RT_NATCNCL";
+        case errors::NE_RT_NOCALLE: return "NE_RT_NOCALLE";
         // resources
         case errors::NE_RS_TREEGER: return "NE_RS_TREEGER";
         case errors::NE_RS_UNBLDRE: return "NE_RS_UNBLDRE";
@@ -89,6 +94,9 @@ string __findStatusCodeDesc(errors::StatusCode code) {
         case errors::NE_OS_INVMSGA: return "Invalid message box style arguments: %1";
         case errors::NE_OS_TRAYIER: return "Unable to initialize the tray menu";
         case errors::NE_OS_INVKNPT: return "Invalid platform path name: %1";
+        case errors::NE_OS_INVPOOL: return "Unable to find process pool: %1";
+        case errors::NE_OS_PRWKEXT: return "Process pool worker exited with code %1 before responding";
+        case errors::NE_OS_PRWKFRM: return "Process pool worker sent a response larger than %1 bytes";
         // computer
         case errors::NE_CO_UNLTOSC: return "Unable to set mouse cursor";
         case errors::NE_CO_UNLTOMG: return "Unable to set mouse grabbinng";
@@ -117,6 +125,8 @@ string __findStatusCodeDesc(errors::StatusCode code) {
         case errors::NE_RT_NATPRME: return "Missing permission to execute the native method: %1";
         case errors::NE_RT_NATRTER: return "Native method execution error occurred. Required parameter is missing: %1";
         case errors::NE_RT_NATNTIM: return "%1 is not implemented in the Neutralinojs server";
+        case errors::NE_RT_NATCNCL: return "Native method call was cancelled: %1";
+        case errors::NE_RT_NOCALLE: return "Unable to find an in-flight native call with id: %1";
         // resources
         case errors::NE_RS_TREEGER: return "Resource file tree generation error. %1 is missing.";
         case errors::NE_RS_UNBLDRE: return "Unable to load application resource file %1";
@@ -25,6 +25,9 @@ enum StatusCode {
     NE_OS_INVMSGA,
     NE_OS_TRAYIER,
     NE_OS_INVKNPT,
+    NE_OS_INVPOOL,
+    NE_OS_PRWKEXT,
+    NE_OS_PRWKFRM,
     // computer
     NE_CO_UNLTOSC,
     NE_CO_UNLTOMG,
@@ -53,6 +56,8 @@ enum StatusCode {
     NE_RT_NATPRME,
     NE_RT_NATRTER,
     NE_RT_NATNTIM,
+    NE_RT_NATCNCL,
+    NE_RT_NOCALLE,
     // resources
     NE_RS_TREEGER,
     NE_RS_UNBLDRE,
@@ -7,9 +7,11 @@
 #include <ctype.h>
 #include <random>
 #include <optional>
+#include <string_view>
 
 #include "helpers.h"
 #include "lib/json/json.hpp"
+#include "lib/base64/base64.hpp"
 
 #if defined(_WIN32)
 #include <string>
@@ -64,37 +66,6 @@ string generateToken() {
     return token;
 }
 
-/*
-* https://stackoverflow.com/a/14530993 - mini url decoder
-*/
-void urldecode(char *dst, const char *src) {
-    char a, b;
-    while (*src) {
-        if ((*src == '%') &&
-            ((a = src[1]) && (b = src[2])) &&
-            (isxdigit(a) && isxdigit(b))) {
-            if (a >= 'a')
-                a -= 'a' - 'A';
-            if (a >= 'A')
-                a -= ('A' - 10);
-            else
-                a -= '0';
-            if (b >= 'a')
-                b -= 'a' - 'A';
-            if (b >= 'A')
-                b -= ('A' - 10);
-            else
-                b -= '0';
-            *dst++ = 16 * a + b;
-            src += 3;
-        }
-        else {
-            *dst++ = *src++;
-        }
-    }
-    *dst++ = '\0';
-}
-
 char* cStrCopy(const string &str) {
     char *text = new char[str.size() + 1];
     copy(str.begin(), str.end(), text);
@@ -175,10 +146,64 @@ string unNormalizePath(string &path) {
     return path;
 }
 
+bool __hasBinaryValue(const json &obj) {
+    if(obj.is_binary()) {
+        return true;
+    }
+    if(obj.is_structured()) {
+        for(const auto &value: obj) {
+            if(__hasBinaryValue(value)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void __binaryToBase64(json &obj) {
+    if(obj.is_binary()) {
+        const json::binary_t &bytes = obj.get_binary();
+        obj = base64::to_base64(string(bytes.begin(), bytes.end()));
+        return;
+    }
+    if(obj.is_structured()) {
+        for(auto &value: obj) {
+            __binaryToBase64(value);
+        }
+    }
+}
+
 string jsonToString(const json &obj) {
+    // Text messages carry binary values (i.e., file contents) as base64 strings
+    if(__hasBinaryValue(obj)) {
+        json textObj = obj;
+        __binaryToBase64(textObj);
+        return textObj.dump(-1, ' ', false, json::error_handler_t::replace);
+    }
     return obj.dump(-1, ' ', false, json::error_handler_t::replace);
 }
 
+json binaryToJson(const string &data) {
+    return json::binary(json::binary_t::container_type(data.begin(), data.end()));
+}
+
+string jsonToBinary(const json &value) {
+    if(value.is_binary()) {
+        const json::binary_t &bytes = value.get_binary();
+        return string(bytes.begin(), bytes.end());
+    }
+    return base64::from_base64(value.get<string>());
+}
+
+bool startsWith(string_view str, string_view prefix) {
+    return str.size() >= prefix.size() && str.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool endsWith(string_view str, string_view suffix) {
+    return str.size() >= suffix.size() &&
+        str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
 #if defined(_WIN32)
 wstring str2wstr(const string &str) {
     int len = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.size(), nullptr, 0);
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <optional>
+#include <string_view>
 
 #if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
 #define CONVSTR(S) S
@@ -27,7 +28,6 @@ namespace helpers {
 vector<string> split(const string &s, char delim, unsigned int stopAfter = -1);
 vector<string> splitTwo(const string &s, char delim);
 string generateToken();
-void urldecode(char *dst, const char *src);
 char* cStrCopy(const string &str);
 bool hasRequiredFields(const json &input, const vector<string> &keys);
 optional<string> missingRequiredField(const json &input, const vector<string> &keys);
@@ -38,6 +38,10 @@ string normalizePath(string &path);
 string unNormalizePath(string &path);
 string getCurrentTimestamp();
 string jsonToString(const json &obj);
+json binaryToJson(const string &data);
+string jsonToBinary(const json &value);
+bool startsWith(string_view str, string_view prefix);
+bool endsWith(string_view str, string_view suffix);
 
 #if defined(_WIN32)
 wstring str2wstr(const string &str);
@@ -48,6 +48,13 @@ Process::id_type Process::get_id() const noexcept {
   return data.id;
 }
 
+void Process::start_read_thread() noexcept {
+  if(config.read_in_thread)
+    return;
+  config.read_in_thread = true;
+  async_read();
+}
+
 bool Process::write(const std::string &str) {
   return write(str.c_str(), str.size());
 }
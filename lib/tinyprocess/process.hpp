@@ -40,6 +40,11 @@ struct Config {
   };
   /// On Windows only: controls how the window is shown.
   ShowWindow show_window{ShowWindow::show_default};
+
+  /// Set to false to read stdout and stderr from an external event loop instead of a thread per process.
+  /// The pipes are available through get_stdout_fd() and get_stderr_fd(). Default is true.
+  /// On Unix-like systems only.
+  bool read_in_thread = true;
 };
 
 /// Platform independent class for creating processes.
@@ -117,6 +122,15 @@ public:
 
   /// Get the process id of the started process.
   id_type get_id() const noexcept;
+#ifndef _WIN32
+  /// Get the read end of the stdout pipe, or -1 if stdout is not redirected.
+  fd_type get_stdout_fd() const noexcept;
+  /// Get the read end of the stderr pipe, or -1 if stderr is not redirected.
+  fd_type get_stderr_fd() const noexcept;
+#endif
+  /// Start reading stdout and stderr in a thread after all, if the process was created with
+  /// Config::read_in_thread = false and the external event loop can't read its pipes.
+  void start_read_thread() noexcept;
   /// Wait until process is finished, and return exit status.
   int get_exit_status() noexcept;
   /// If process is finished, returns true and sets the exit status. Returns false otherwise.
@@ -158,7 +172,10 @@ private:
   id_type open(const std::vector<string_type> &arguments, const string_type &path, const environment_type *environment = nullptr) noexcept;
   id_type open(const string_type &command, const string_type &path, const environment_type *environment = nullptr) noexcept;
 #ifndef _WIN32
-  id_type open(const std::function<void()> &function) noexcept;
+  /// Starts the process without fork() if possible. Gets the pipe ends to redirect to stdin, stdout
+  /// and stderr (-1 if not redirected) and all pipe fds to close, returns -1 to fall back to fork().
+  typedef std::function<id_type(const fd_type *child_fds, const std::vector<fd_type> &pipe_fds)> spawn_function;
+  id_type open(const std::function<void()> &function, const spawn_function &spawn = nullptr) noexcept;
 #endif
   void async_read() noexcept;
   void close_fds() noexcept;
@@ -6,11 +6,67 @@
 #include <poll.h>
 #include <set>
 #include <signal.h>
+#include <spawn.h>
 #include <stdexcept>
 #include <unistd.h>
 
+extern char **environ;
+
 namespace TinyProcessLib {
 
+namespace {
+void make_environment(const Process::environment_type &environment, std::vector<std::string> &env_strs, std::vector<const char *> &env_ptrs) {
+  env_strs.reserve(environment.size());
+  env_ptrs.reserve(environment.size() + 1);
+  for(const auto &e : environment) {
+    env_strs.emplace_back(e.first + '=' + e.second);
+    env_ptrs.emplace_back(env_strs.back().c_str());
+  }
+  env_ptrs.emplace_back(nullptr);
+}
+
+// Starts the process with posix_spawn, which glibc implements with clone(CLONE_VM | CLONE_VFORK),
+// so the cost does not grow with the parent's memory size. Returns -1 if the file actions
+// can't express the fork path's setup, and the caller falls back to fork().
+Process::id_type spawn_process(const char *file, const char *const *argv, const char *const *envp, const std::string &path,
+                               const Process::fd_type *child_fds, const std::vector<Process::fd_type> &pipe_fds,
+                               bool inherit_file_descriptors) noexcept {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attributes;
+  if(posix_spawn_file_actions_init(&actions) != 0)
+    return -1;
+  if(posix_spawnattr_init(&attributes) != 0) {
+    posix_spawn_file_actions_destroy(&actions);
+    return -1;
+  }
+
+  bool ok = posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP) == 0 &&
+            posix_spawnattr_setpgroup(&attributes, 0) == 0;
+  for(int fd = 0; ok && fd < 3; fd++) {
+    if(child_fds[fd] >= 0)
+      ok = posix_spawn_file_actions_adddup2(&actions, child_fds[fd], fd) == 0;
+  }
+  for(size_t i = 0; ok && i < pipe_fds.size(); i++)
+    ok = posix_spawn_file_actions_addclose(&actions, pipe_fds[i]) == 0;
+  if(ok && !inherit_file_descriptors)
+    ok = posix_spawn_file_actions_addclosefrom_np(&actions, 3) == 0;
+  if(ok && !path.empty())
+    ok = posix_spawn_file_actions_addchdir_np(&actions, path.c_str()) == 0;
+
+  Process::id_type pid = -1;
+  if(ok && posix_spawn(&pid, file, &actions, &attributes, const_cast<char *const *>(argv), const_cast<char *const *>(envp)) != 0)
+    pid = -1;
+
+  posix_spawnattr_destroy(&attributes);
+  posix_spawn_file_actions_destroy(&actions);
+  return pid;
+#else
+  return -1;
+#endif
+}
+} // namespace
+
 Process::Data::Data() noexcept : id(-1) {}
 
 Process::Process(const std::function<void()> &function,
@@ -22,7 +78,7 @@ Process::Process(const std::function<void()> &function,
   async_read();
 }
 
-Process::id_type Process::open(const std::function<void()> &function) noexcept {
+Process::id_type Process::open(const std::function<void()> &function, const spawn_function &spawn) noexcept {
   if(open_stdin)
     stdin_fd = std::unique_ptr<fd_type>(new fd_type);
   if(read_stdout)
@@ -53,7 +109,26 @@ Process::id_type Process::open(const std::function<void()> &function) noexcept {
     return -1;
   }
 
-  id_type pid = fork();
+  id_type pid = -1;
+  if(spawn) {
+    std::vector<fd_type> pipe_fds;
+    fd_type child_fds[3] = {-1, -1, -1};
+    if(stdin_fd) {
+      pipe_fds.insert(pipe_fds.end(), {stdin_p[0], stdin_p[1]});
+      child_fds[0] = stdin_p[0];
+    }
+    if(stdout_fd) {
+      pipe_fds.insert(pipe_fds.end(), {stdout_p[0], stdout_p[1]});
+      child_fds[1] = stdout_p[1];
+    }
+    if(stderr_fd) {
+      pipe_fds.insert(pipe_fds.end(), {stderr_p[0], stderr_p[1]});
+      child_fds[2] = stderr_p[1];
+    }
+    pid = spawn(child_fds, pipe_fds);
+  }
+  if(pid < 0)
+    pid = fork();
 
   if(pid < 0) {
     if(stdin_fd) {
@@ -129,16 +204,21 @@ Process::id_type Process::open(const std::function<void()> &function) noexcept {
 }
 
 Process::id_type Process::open(const std::vector<string_type> &arguments, const string_type &path, const environment_type *environment) noexcept {
-  return open([&arguments, &path, &environment] {
+  std::vector<const char *> argv_ptrs;
+  argv_ptrs.reserve(arguments.size() + 1);
+  for(auto &argument : arguments)
+    argv_ptrs.emplace_back(argument.c_str());
+  argv_ptrs.emplace_back(nullptr);
+
+  std::vector<std::string> env_strs;
+  std::vector<const char *> env_ptrs;
+  if(environment)
+    make_environment(*environment, env_strs, env_ptrs);
+
+  return open([&arguments, &path, &environment, &argv_ptrs, &env_ptrs] {
     if(arguments.empty())
       exit(127);
 
-    std::vector<const char *> argv_ptrs;
-    argv_ptrs.reserve(arguments.size() + 1);
-    for(auto &argument : arguments)
-      argv_ptrs.emplace_back(argument.c_str());
-    argv_ptrs.emplace_back(nullptr);
-
     if(!path.empty()) {
       if(chdir(path.c_str()) != 0)
         exit(1);
@@ -146,57 +226,51 @@ Process::id_type Process::open(const std::vector<string_type> &arguments, const
 
     if(!environment)
       execv(arguments[0].c_str(), const_cast<char *const *>(argv_ptrs.data()));
-    else {
-      std::vector<std::string> env_strs;
-      std::vector<const char *> env_ptrs;
-      env_strs.reserve(environment->size());
-      env_ptrs.reserve(environment->size() + 1);
-      for(const auto &e : *environment) {
-        env_strs.emplace_back(e.first + '=' + e.second);
-        env_ptrs.emplace_back(env_strs.back().c_str());
-      }
-      env_ptrs.emplace_back(nullptr);
-
+    else
       execve(arguments[0].c_str(), const_cast<char *const *>(argv_ptrs.data()), const_cast<char *const *>(env_ptrs.data()));
-    }
+  }, [this, &arguments, &path, &environment, &argv_ptrs, &env_ptrs](const fd_type *child_fds, const std::vector<fd_type> &pipe_fds) {
+    if(arguments.empty())
+      return static_cast<id_type>(-1);
+    return spawn_process(arguments[0].c_str(), argv_ptrs.data(), environment ? env_ptrs.data() : environ, path,
+                         child_fds, pipe_fds, config.inherit_file_descriptors);
   });
 }
 
 Process::id_type Process::open(const std::string &command, const std::string &path, const environment_type *environment) noexcept {
-  return open([&command, &path, &environment] {
-    auto command_c_str = command.c_str();
-    std::string cd_path_and_command;
-    if(!path.empty()) {
-      auto path_escaped = path;
-      size_t pos = 0;
-      // Based on https://www.reddit.com/r/cpp/comments/3vpjqg/a_new_platform_independent_process_library_for_c11/cxsxyb7
-      while((pos = path_escaped.find('\'', pos)) != std::string::npos) {
-        path_escaped.replace(pos, 1, "'\\''");
-        pos += 4;
-      }
-      cd_path_and_command = "cd '" + path_escaped + "' && " + command; // To avoid resolving symbolic links
-      command_c_str = cd_path_and_command.c_str();
+  auto command_c_str = command.c_str();
+  std::string cd_path_and_command;
+  if(!path.empty()) {
+    auto path_escaped = path;
+    size_t pos = 0;
+    // Based on https://www.reddit.com/r/cpp/comments/3vpjqg/a_new_platform_independent_process_library_for_c11/cxsxyb7
+    while((pos = path_escaped.find('\'', pos)) != std::string::npos) {
+      path_escaped.replace(pos, 1, "'\\''");
+      pos += 4;
     }
+    cd_path_and_command = "cd '" + path_escaped + "' && " + command; // To avoid resolving symbolic links
+    command_c_str = cd_path_and_command.c_str();
+  }
+
+  std::vector<std::string> env_strs;
+  std::vector<const char *> env_ptrs;
+  if(environment)
+    make_environment(*environment, env_strs, env_ptrs);
 
+  return open([&command_c_str, &environment, &env_ptrs] {
     if(!environment)
       execl("/bin/sh", "/bin/sh", "-c", command_c_str, nullptr);
-    else {
-      std::vector<std::string> env_strs;
-      std::vector<const char *> env_ptrs;
-      env_strs.reserve(environment->size());
-      env_ptrs.reserve(environment->size() + 1);
-      for(const auto &e : *environment) {
-        env_strs.emplace_back(e.first + '=' + e.second);
-        env_ptrs.emplace_back(env_strs.back().c_str());
-      }
-      env_ptrs.emplace_back(nullptr);
+    else
       execle("/bin/sh", "/bin/sh", "-c", command_c_str, nullptr, env_ptrs.data());
-    }
+  }, [this, &command_c_str, &environment, &env_ptrs](const fd_type *child_fds, const std::vector<fd_type> &pipe_fds) {
+    const char *argv[] = {"/bin/sh", "-c", command_c_str, nullptr};
+    // The working directory is set by the shell command above
+    return spawn_process("/bin/sh", argv, environment ? env_ptrs.data() : environ, std::string(),
+                         child_fds, pipe_fds, config.inherit_file_descriptors);
   });
 }
 
 void Process::async_read() noexcept {
-  if(data.id <= 0 || (!stdout_fd && !stderr_fd))
+  if(data.id <= 0 || (!stdout_fd && !stderr_fd) || !config.read_in_thread)
     return;
 
   stdout_stderr_thread = std::thread([this] {
@@ -243,6 +317,14 @@ void Process::async_read() noexcept {
   });
 }
 
+Process::fd_type Process::get_stdout_fd() const noexcept {
+  return stdout_fd && data.id > 0 ? *stdout_fd : -1;
+}
+
+Process::fd_type Process::get_stderr_fd() const noexcept {
+  return stderr_fd && data.id > 0 ? *stderr_fd : -1;
+}
+
 int Process::get_exit_status() noexcept {
   if(data.id <= 0)
     return -1;
@@ -307,8 +389,7 @@ void Process::close_fds() noexcept {
   if(stdout_stderr_thread.joinable())
     stdout_stderr_thread.join();
 
-  if(stdin_fd)
-    close_stdin();
+  close_stdin(); // Checks stdin_fd under stdin_mutex, since stdin can be closed from another thread
   if(stdout_fd) {
     if(data.id > 0)
       close(*stdout_fd);
@@ -150,6 +150,14 @@ typedef lib::function<bool(connection_hdl)> validate_handler;
  */
 typedef lib::function<void(connection_hdl)> http_handler;
 
+/// The type and function signature of a body reader
+/**
+ * The body reader is called to read the next part of a streamed HTTP response
+ * body into the buffer. It returns the number of bytes read. Returning 0 before
+ * the whole body was read closes the connection.
+ */
+typedef lib::function<size_t(char *, size_t)> body_reader;
+
 //
 typedef lib::function<void(lib::error_code const & ec, size_t bytes_transferred)> read_handler;
 typedef lib::function<void(lib::error_code const & ec)> write_frame_handler;
@@ -316,6 +324,7 @@ public:
       , m_state(session::state::connecting)
       , m_internal_state(session::internal_state::USER_INIT)
       , m_msg_manager(new con_msg_manager_type())
+      , m_body_remaining(0)
       , m_send_buffer_size(0)
       , m_write_flag(false)
       , m_read_flag(true)
@@ -1042,6 +1051,24 @@ public:
      */
     void set_body(std::string const & value);
 
+    /// Set response body content without copying it
+    /**
+     * @param value String data to move into the body content.
+     * @see websocketpp::connection::set_body
+     */
+    void set_body(std::string && value);
+
+    /// Stream the response body from a reader
+    /**
+     * The body is written in parts after the headers, so large bodies don't
+     * have to be held in memory. The reader is called from the transport's
+     * thread until it has returned size bytes.
+     *
+     * @param size The size of the body, sent as the Content-Length.
+     * @param reader The function that reads the next part of the body.
+     */
+    void set_body_reader(size_t size, body_reader reader);
+
     /// Append a header
     /**
      * If a header with this name already exists the value will be appended to
@@ -1550,6 +1577,10 @@ private:
     /// handshake.
     std::string m_handshake_buffer;
 
+    /// Reads the streamed HTTP response body, if any
+    body_reader m_body_reader;
+    size_t m_body_remaining;
+
     /// Pointer to the processor object for this connection
     /**
      * The processor provides functionality that is specific to the WebSocket
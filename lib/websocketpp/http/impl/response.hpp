@@ -183,9 +183,12 @@ inline std::string response::raw() const {
     ret << get_version() << " " << m_status_code << " " << m_status_msg;
     ret << "\r\n" << raw_headers() << "\r\n";
 
-    ret << m_body;
+    // The body is appended directly, a stringstream would copy it twice
+    std::string raw = ret.str();
+    raw.reserve(raw.size() + m_body.size());
+    raw.append(m_body);
 
-    return ret.str();
+    return raw;
 }
 
 inline void response::set_status(status_code::value code) {
@@ -517,6 +517,9 @@ public:
      */
     void set_body(std::string const & value);
 
+    /// Set body content without copying it
+    void set_body(std::string && value);
+
     /// Get body size limit
     /**
      * Retrieves the maximum number of bytes to parse & buffer before canceling
@@ -575,6 +575,31 @@ void connection<config>::set_body(std::string const & value) {
     m_response.set_body(value);
 }
 
+template <typename config>
+void connection<config>::set_body(std::string && value) {
+    if (m_internal_state != istate::PROCESS_HTTP_REQUEST) {
+        throw exception("Call to set_status from invalid state",
+                      error::make_error_code(error::invalid_state));
+    }
+
+    m_response.set_body(std::move(value));
+}
+
+template <typename config>
+void connection<config>::set_body_reader(size_t size, body_reader reader) {
+    if (m_internal_state != istate::PROCESS_HTTP_REQUEST) {
+        throw exception("Call to set_body_reader from invalid state",
+                      error::make_error_code(error::invalid_state));
+    }
+
+    m_response.set_body(std::string());
+    std::stringstream len;
+    len << size;
+    m_response.replace_header("Content-Length", len.str());
+    m_body_reader = reader;
+    m_body_remaining = size;
+}
+
 // TODO: EXCEPTION_FREE
 template <typename config>
 void connection<config>::append_header(std::string const & key,
@@ -1390,6 +1415,33 @@ void connection<config>::handle_write_http_response(lib::error_code const & ec)
         m_handshake_timer.reset();
     }
 
+    // A streamed body is written in parts after the headers
+    if (m_body_reader && m_body_remaining > 0) {
+        static size_t const body_part_size = 65536;
+        size_t length = (std::min)(m_body_remaining, body_part_size);
+        m_handshake_buffer.resize(length);
+        size_t read = m_body_reader(&m_handshake_buffer[0], length);
+        if (read == 0 || read > length) {
+            m_body_reader = body_reader();
+            log_err(log::elevel::rerror,"handle_write_http_response",
+                error::make_error_code(error::general));
+            this->terminate(error::make_error_code(error::general));
+            return;
+        }
+        m_body_remaining -= read;
+        transport_con_type::async_write(
+            m_handshake_buffer.data(),
+            read,
+            lib::bind(
+                &type::handle_write_http_response,
+                type::get_shared(),
+                lib::placeholders::_1
+            )
+        );
+        return;
+    }
+    m_body_reader = body_reader();
+
     if (m_response.get_status_code() != http::status_code::switching_protocols)
     {
         /*if (m_processor || m_ec == error::http_parse_error || 
@@ -1,6 +1,5 @@
 #include <cstdlib>
 #include <string>
-#include <thread>
 #if defined(_WIN32)
 #include <winsock2.h>
 #include <websocketpp/error.hpp>
@@ -12,7 +11,9 @@
 #include "auth/permission.h"
 #include "auth/authbasic.h"
 #include "server/neuserver.h"
+#include "server/router.h"
 #include "settings.h"
+#include "scheduler.h"
 #include "resources.h"
 #include "helpers.h"
 #include "chrome.h"
@@ -34,10 +35,9 @@ using json = nlohmann::json;
 
 string navigationUrl = "";
 
+// The main thread joins the reactor instead of sleeping
 void __wait() {
-    while(true) {
-        this_thread::sleep_for(20000ms);
-    }
+    scheduler::run();
 }
 
 void __startApp() {
@@ -50,6 +50,10 @@ void __startApp() {
         case settings::AppModeWindow: {
             json windowOptions = options["modes"]["window"];
             windowOptions["url"] = navigationUrl;
+            // The main thread runs the window, so the reactor needs a thread without the server
+            if(!neuserver::isInitialized()) {
+                scheduler::startAsync();
+            }
             if(!window::init(windowOptions)) {
                 pfd::message("Unable to create a webview instance",
                     #if defined(_WIN32)
@@ -135,6 +139,7 @@ void __startServerAsync() {
 
 void __initFramework(const json &args) {
     settings::setGlobalArgs(args);
+    scheduler::init();
     resources::init();
     bool settingsStatus = settings::init();
     if(!settingsStatus) {
@@ -146,6 +151,7 @@ void __initFramework(const json &args) {
     }
     authbasic::init();
     permission::init();
+    router::init();
     storage::init();
 }
 
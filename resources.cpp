@@ -3,9 +3,26 @@
 #include <fstream>
 #include <regex>
 #include <vector>
+#include <algorithm>
 #include <filesystem>
+#include <iterator>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 #include <limits.h>
 
+#if defined(_WIN32)
+#define _WINSOCKAPI_
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "lib/postject/postject-api.h"
 #include "lib/easylogging/easylogging++.h"
 #include "lib/json/json.hpp"
@@ -15,30 +32,70 @@
 #include "resources.h"
 #include "api/debug/debug.h"
 #include "api/fs/fs.h"
+#include "server/compression.h"
 
 #define NEU_APP_RES_FILE "/resources.neu"
 #define RESOURCE_NAME_EMBEDDED "NEUTRALINOJS_RESOURCES_NEU"
+#define NEU_RES_BUNDLE_VERSION 1
+#define NEU_EXTRACT_MAX_THREADS 8
+#define NEU_EXTRACT_PROGRESS_INTERVAL 100
 
 using namespace std;
 using json = nlohmann::json;
 
 namespace resources {
 
-json fileTree = nullptr;
 unsigned int asarHeaderSize;
+// The mapped resources.neu or the embedded resources section
+const char *resourceData = nullptr;
+size_t resourceSize = 0;
+// Holds resources.neu if it can't be mapped
+string resourceBuffer;
+// The mapped resources.neu, kept open to copy files in the kernel while extracting
+int resourceFile = -1;
+#if defined(_WIN32)
+// Identifies the mapped resources.neu, since Windows doesn't keep a descriptor of it
+BY_HANDLE_FILE_INFORMATION resourceFileInfo = {};
+bool resourceFileMapped = false;
+#endif
 resources::ResourceMode mode = resources::ResourceModeEmbedded;
+// All files and directories of the bundle in depth-first order and an
+// open-addressing hash table of their paths. Slots hold entry index + 1.
+vector<resources::ResourceEntry> entries;
+vector<uint32_t> entrySlots;
+bool compressedBundle = false;
+// Preset dictionary of compressed bundles
+string_view compressionDictionary;
+
+uint64_t __hashPath(string_view path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(const char c: path) {
+        hash ^= (unsigned char) c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
 
-pair<unsigned long, string> __seekFilePos(const string &path, json node) {
-    vector<string> pathSegments = helpers::split(path, '/');
-    json json = node;
-    for(const auto &pathSegment: pathSegments) {
-        if(pathSegment.size() == 0 || json.is_null() || json["files"].is_null())
-            continue;
-        json = json["files"][pathSegment];
+const resources::ResourceEntry *__findEntry(string_view path) {
+    if(entrySlots.empty()) {
+        return nullptr;
+    }
+    size_t mask = entrySlots.size() - 1;
+    for(size_t slot = __hashPath(path) & mask; entrySlots[slot] != 0; slot = (slot + 1) & mask) {
+        const resources::ResourceEntry &entry = entries[entrySlots[slot] - 1];
+        if(entry.path == path) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// Canonical paths start with a slash and have no empty segments, i.e., /resources/app.js
+bool __isCanonicalPath(string_view path) {
+    if(path == "/") {
+        return true;
     }
-    if(!json.is_null())
-        return make_pair(json["size"].get<unsigned long>(), json["offset"].get<string>());
-    return make_pair(-1, "");
+    return !path.empty() && path.front() == '/' && path.back() != '/' && path.find("//") == string_view::npos;
 }
 
 // Needs explicit close later
@@ -53,147 +110,454 @@ ifstream __openResourceFile() {
     return asarArchive;
 }
 
-fs::FileReaderResult __getFileFromBundle(const string &filename) {
-    fs::FileReaderResult fileReaderResult;
-    pair<long, string> p = __seekFilePos(filename, fileTree);
-    if(p.first != -1) {
-        ifstream asarArchive = __openResourceFile();
-        if (!asarArchive) {
-            fileReaderResult.status = errors::NE_RS_TREEGER;
-            return fileReaderResult;
-        }
-        unsigned long size = p.first;
-        unsigned long uOffset = stoi(p.second);
-
-        vector<char>fileBuf ( size );
-        asarArchive.seekg(asarHeaderSize + uOffset);
-        asarArchive.read(fileBuf.data(), size);
-        string fileContent(fileBuf.begin(), fileBuf.end());
-        fileReaderResult.data = fileContent;
-        asarArchive.close();
-   }
-   else {
-        fileReaderResult.status = errors::NE_RS_NOPATHE;
-   }
-   return fileReaderResult;
-}
-
-fs::FileReaderResult __getFileFromEmbedded(const string &filename) {
-    fs::FileReaderResult fileReaderResult;
-    pair<long, string> p = __seekFilePos(filename, fileTree);
-    if(p.first != -1) {
-        size_t resource_size = 0;
-        const void* resource_ptr = postject_find_resource(RESOURCE_NAME_EMBEDDED, &resource_size, NULL);
-        if (resource_ptr == NULL || resource_size <= 0) {
-            fileReaderResult.status = errors::NE_RS_TREEGER;
-            return fileReaderResult;
+// Maps resources.neu into memory, so files are read from the page cache without
+// opening the bundle per file. The mapping is never released.
+bool __mapResourceFile() {
+    string resFileName = settings::joinAppPath(NEU_APP_RES_FILE);
+    #if defined(_WIN32)
+    // A bundle that was replaced while it was mapped can't be deleted until the app exits
+    DeleteFileW(CONVSTR(resFileName + NEU_REPLACED_FILE_SUFFIX).c_str());
+    // Sharing delete access lets fs::writeFile move the mapped file aside
+    HANDLE file = CreateFileW(CONVSTR(resFileName).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER fileSize;
+        HANDLE mapping = nullptr;
+        if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
         }
-
-        const unsigned char* bytes = (const unsigned char*)resource_ptr;
-        unsigned long size = p.first;
-        unsigned long uOffset = stoi(p.second);
-
-        vector<char>fileBuf ( size );
-        for (size_t i = asarHeaderSize + uOffset; i < asarHeaderSize + uOffset + size; i++) {
-          fileBuf[i - (asarHeaderSize + uOffset)] = bytes[i];
+        if(mapping) {
+            resourceData = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            resourceSize = resourceData ? (size_t) fileSize.QuadPart : 0;
+            resourceFileMapped = resourceData && GetFileInformationByHandle(file, &resourceFileInfo);
+            // The view keeps the mapping open
+            CloseHandle(mapping);
         }
+        CloseHandle(file);
+    }
+    #else
+    int fd = open(resFileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd >= 0) {
+        struct stat fileStats;
+        if(fstat(fd, &fileStats) == 0 && fileStats.st_size > 0) {
+            void *data = mmap(nullptr, fileStats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(data != MAP_FAILED) {
+                resourceData = (const char *) data;
+                resourceSize = fileStats.st_size;
+                resourceFile = fd;
+            }
+        }
+        if(resourceFile < 0) {
+            close(fd);
+        }
+    }
+    #endif
+    if(resourceData) {
+        return true;
+    }
 
-        string fileContent(fileBuf.begin(), fileBuf.end());
-        fileReaderResult.data = fileContent;
-   }
-   else {
-        fileReaderResult.status = errors::NE_RS_NOPATHE;
-   }
-   return fileReaderResult;
-}
-
-bool __makeBundleFileTree() {
+    // Loads the whole bundle if it can't be mapped
     ifstream asarArchive = __openResourceFile();
-    if (!asarArchive) {
+    if(!asarArchive) {
         return false;
     }
-
-    char *sizeBuf = new char[8];
-    asarArchive.read(sizeBuf, 8);
-    unsigned int size = *(unsigned int *)(sizeBuf + 4) - 8;
-
-    delete[] sizeBuf;
-
-    asarHeaderSize = size + 16;
-    vector<char> headerBuf(size);
-    asarArchive.seekg(16);
-    asarArchive.read(headerBuf.data(), size);
-    json files;
-    string headerContent(headerBuf.begin(), headerBuf.end());
+    resourceBuffer.assign(istreambuf_iterator<char>(asarArchive), istreambuf_iterator<char>());
     asarArchive.close();
-    try {
-        files = json::parse(headerContent);
-    }
-    catch(const exception& e) {
-        debug::log(debug::LogTypeError, e.what());
-    }
-    fileTree = files;
-    return fileTree != nullptr;
+    resourceData = resourceBuffer.data();
+    resourceSize = resourceBuffer.size();
+    return true;
 }
 
-bool __makeEmbeddedFileTree() {
+// The embedded resources are a section of the executable, so they are only looked up once
+bool __findEmbeddedResources() {
     size_t resource_size = 0;
     const void* resource_ptr = postject_find_resource(RESOURCE_NAME_EMBEDDED, &resource_size, NULL);
     if (resource_ptr == NULL || resource_size <= 0) {
       return false;
     }
+    resourceData = (const char *) resource_ptr;
+    resourceSize = resource_size;
+    return true;
+}
 
-    const unsigned char* bytes = (const unsigned char*)resource_ptr;
-    char *sizeBuf = new char[8];
-    for (size_t i = 0; i < 8; ++i) {
-      sizeBuf[i] = bytes[i];
+// Applies the optional read position and size of a file reader to a file
+// and returns the position and size to read
+pair<uint64_t, uint64_t> __getReadRange(uint64_t size, const fs::FileReaderOptions &fileReaderOptions) {
+    uint64_t pos = 0;
+    if(fileReaderOptions.pos > -1) {
+        pos = min((uint64_t) fileReaderOptions.pos, size);
+    }
+    size -= pos;
+    if(fileReaderOptions.size > -1) {
+        size = min((uint64_t) fileReaderOptions.size, size);
     }
+    return make_pair(pos, size);
+}
 
-    unsigned int size = *(unsigned int *)(sizeBuf + 4) - 8;
-    delete[] sizeBuf;
+// Views a region of the bundle's data section. Returns false if the region
+// is not within the bundle.
+bool __viewBundleData(uint64_t offset, uint64_t size, string_view &data) {
+    uint64_t dataSize = resourceSize - asarHeaderSize;
+    if(offset > dataSize || size > dataSize - offset) {
+        return false;
+    }
+    data = string_view(resourceData + asarHeaderSize + offset, size);
+    return true;
+}
 
-    asarHeaderSize = size + 16;
-    vector<char> headerBuf(size);
-    for (size_t i = 16; i < 16 + size; ++i) {
-      headerBuf[i - 16] = bytes[i];
+// Adds a header node and its children. Files without an offset in the
+// bundle (i.e., unpacked files) are skipped.
+void __addEntries(const json &node, const string &path) {
+    size_t index = entries.size();
+    entries.push_back({path});
+    auto files = node.find("files");
+    if(files != node.end() && files->is_object()) {
+        entries[index].isDirectory = true;
+        for(const auto &[name, child]: files->items()) {
+            __addEntries(child, path + "/" + name);
+        }
+        entries[index].subtreeSize = entries.size() - index - 1;
+        return;
     }
+    auto offset = node.find("offset");
+    auto size = node.find("size");
+    if(offset == node.end() || !offset->is_string() || size == node.end() || !size->is_number_unsigned()) {
+        entries.pop_back();
+        return;
+    }
+    // Offsets are strings since they can be larger than 2^53
+    entries[index].offset = stoull(offset->get<string>());
+    entries[index].size = size->get<uint64_t>();
+    auto compressedSize = node.find("compressedSize");
+    if(compressedBundle && compressedSize != node.end() && compressedSize->is_number_unsigned()) {
+        entries[index].compressedSize = compressedSize->get<uint64_t>();
+    }
+}
+
+// Compressed bundles are asar archives with a neuBundle header field. Their
+// compressed files have a compressedSize field next to the original size.
+bool __readBundleInfo(const json &bundleInfo) {
+    if(!bundleInfo.is_object() || bundleInfo.value("version", 0) != NEU_RES_BUNDLE_VERSION) {
+        debug::log(debug::LogTypeError, "Unsupported resource bundle version");
+        return false;
+    }
+    if(bundleInfo.value("compression", "") != "deflate" || !compression::isGzipAvailable()) {
+        debug::log(debug::LogTypeError, "Unsupported resource bundle compression");
+        return false;
+    }
+    compressionDictionary = {};
+    auto dictionary = bundleInfo.find("dictionary");
+    if(dictionary != bundleInfo.end() && !__viewBundleData(stoull(dictionary->at("offset").get<string>()),
+        dictionary->at("size").get<uint64_t>(), compressionDictionary)) {
+        return false;
+    }
+    compressedBundle = true;
+    return true;
+}
 
-    json files;
-    string headerContent(headerBuf.begin(), headerBuf.end());
+void __makeEntrySlots() {
+    size_t capacity = 16;
+    while(capacity < entries.size() * 2) {
+        capacity *= 2;
+    }
+    entrySlots.assign(capacity, 0);
+    size_t mask = capacity - 1;
+    for(size_t i = 0; i < entries.size(); i++) {
+        size_t slot = __hashPath(entries[i].path) & mask;
+        while(entrySlots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        entrySlots[slot] = i + 1;
+    }
+}
+
+// Parses the asar header once into the entry index
+bool __makeFileIndex() {
+    if(resourceSize < 16) {
+        return false;
+    }
+    uint32_t headerPickleSize;
+    memcpy(&headerPickleSize, resourceData + 4, sizeof(headerPickleSize));
+    if(headerPickleSize < 8 || headerPickleSize - 8 > resourceSize - 16) {
+        return false;
+    }
+    unsigned int size = headerPickleSize - 8;
+    asarHeaderSize = size + 16;
+
+    entries.clear();
+    compressedBundle = false;
     try {
-        files = json::parse(headerContent);
+        json files = json::parse(resourceData + 16, resourceData + 16 + size);
+        if(!files.is_object() || !files.contains("files")) {
+            return false;
+        }
+        auto bundleInfo = files.find("neuBundle");
+        if(bundleInfo != files.end() && !__readBundleInfo(*bundleInfo)) {
+            return false;
+        }
+        __addEntries(files, "");
+        entries[0].path = "/";
     }
     catch(const exception& e) {
         debug::log(debug::LogTypeError, e.what());
+        entries.clear();
+        return false;
+    }
+    __makeEntrySlots();
+    return true;
+}
+
+resources::FileView __getFileView(const resources::ResourceEntry *entry, const fs::FileReaderOptions &fileReaderOptions) {
+    resources::FileView fileView;
+    auto [readPos, readSize] = __getReadRange(entry->size, fileReaderOptions);
+    if(entry->compressedSize == 0) {
+        if(!__viewBundleData(entry->offset + readPos, readSize, fileView.data)) {
+            fileView.status = errors::NE_RS_UNBLDRE;
+        }
+        return fileView;
+    }
+    // Compressed files are inflated as a whole, even for partial reads
+    string_view compressedData;
+    fileView.buffer = make_shared<string>();
+    if(!__viewBundleData(entry->offset, entry->compressedSize, compressedData) ||
+        !compression::inflateRaw(compressedData, compressionDictionary, entry->size, *fileView.buffer)) {
+        fileView.status = errors::NE_RS_UNBLDRE;
+        fileView.buffer = nullptr;
+        return fileView;
     }
-    fileTree = files;
-    return fileTree != nullptr;
+    fileView.data = string_view(*fileView.buffer).substr(readPos, readSize);
+    return fileView;
+}
+
+// Writes a bundle file to the output file straight from the mapped bundle.
+// Stored files of resources.neu are copied in the kernel if possible.
+bool __extractFile(const resources::ResourceEntry *entry, const string &outputFilename) {
+    resources::FileView fileView = __getFileView(entry, {});
+    if(fileView.status != errors::NE_ST_OK) {
+        return false;
+    }
+    #if defined(_WIN32)
+    ofstream outputFile(CONVSTR(outputFilename), ios::binary | ios::trunc);
+    outputFile.write(fileView.data.data(), fileView.data.size());
+    return outputFile.good();
+    #else
+    int fd = open(outputFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) {
+        return false;
+    }
+    string_view data = fileView.data;
+    #if defined(__linux__)
+    if(resourceFile >= 0 && !fileView.buffer) {
+        loff_t inputOffset = data.data() - resourceData;
+        while(!data.empty()) {
+            ssize_t copied = copy_file_range(resourceFile, &inputOffset, fd, nullptr, data.size(), 0);
+            if(copied <= 0) {
+                // Not supported for these files (i.e., across file systems on old kernels), so write what's left
+                break;
+            }
+            data.remove_prefix(copied);
+        }
+    }
+    #endif
+    while(!data.empty()) {
+        ssize_t written = write(fd, data.data(), data.size());
+        if(written < 0 && errno == EINTR) {
+            continue;
+        }
+        if(written <= 0) {
+            break;
+        }
+        data.remove_prefix(written);
+    }
+    return close(fd) == 0 && data.empty();
+    #endif
 }
 
 bool extractFile(const string &filename, const string &outputFilename) {
-    fs::FileReaderResult fileReaderResult = resources::getFile(filename);
-    if(fileReaderResult.status != errors::NE_ST_OK) {
+    const resources::ResourceEntry *entry = resources::getEntry(filename);
+    if(!entry || entry->isDirectory) {
         return false;
     }
     auto extractPath = filesystem::path(CONVSTR(outputFilename));
     if(!extractPath.parent_path().empty()) {
         filesystem::create_directories(extractPath.parent_path());
     }
-   
-    fs::FileWriterOptions fileWriterOptions;
-    fileWriterOptions.filename = outputFilename;
-    fileWriterOptions.data = fileReaderResult.data;
-    return fs::writeFile(fileWriterOptions);
+    return __extractFile(entry, outputFilename);
 }
 
-fs::FileReaderResult getFile(const string &filename) {
-    if (resources::isEmbeddedMode()) {
-        return __getFileFromEmbedded(filename);
+// Extracts a bundle directory to the destination on a few worker threads. The
+// directories are created first, so workers only write files. Progress is
+// reported from the worker threads at most every 100 ms, and once at the end.
+// Returns false if a file couldn't be extracted.
+bool extractDirectory(const string &path, const string &destination,
+    const resources::ExtractionProgressHandler &progressHandler) {
+    const resources::ResourceEntry *dirEntry = resources::getEntry(path);
+    if(!dirEntry || !dirEntry->isDirectory) {
+        return false;
     }
-    if(resources::isBundleMode()) {
-        return __getFileFromBundle(filename);
+    size_t dirPathSize = dirEntry->path != "/" ? dirEntry->path.size() + 1 : 1;
+    filesystem::path destinationPath = CONVSTR(destination);
+    auto getOutputFilename = [&](const resources::ResourceEntry *entry) {
+        return FS_CONVWSTR((destinationPath / filesystem::path(CONVSTR(entry->path.substr(dirPathSize)))));
+    };
+
+    vector<const resources::ResourceEntry *> files;
+    resources::ExtractionProgress progress;
+    error_code ec;
+    filesystem::create_directories(destinationPath, ec);
+    // Entries are in depth-first order, so parents are created before their children
+    for(const resources::ResourceEntry *entry: resources::getEntries(path)) {
+        if(entry->isDirectory) {
+            filesystem::create_directory(CONVSTR(getOutputFilename(entry)), ec);
+            continue;
+        }
+        files.push_back(entry);
+        progress.totalBytes += entry->size;
+    }
+    progress.totalFiles = files.size();
+
+    atomic<size_t> nextFile(0);
+    atomic<uint64_t> extractedFiles(0);
+    atomic<uint64_t> extractedBytes(0);
+    atomic<bool> failed(false);
+    mutex progressLock;
+    auto lastProgressTime = chrono::steady_clock::now();
+    auto extractFiles = [&]() {
+        for(size_t i; (i = nextFile++) < files.size();) {
+            if(!__extractFile(files[i], getOutputFilename(files[i]))) {
+                failed = true;
+                continue;
+            }
+            extractedFiles++;
+            extractedBytes += files[i]->size;
+            unique_lock<mutex> guard(progressLock, try_to_lock);
+            auto now = chrono::steady_clock::now();
+            if(!progressHandler || !guard.owns_lock() ||
+                now - lastProgressTime < chrono::milliseconds(NEU_EXTRACT_PROGRESS_INTERVAL)) {
+                continue;
+            }
+            lastProgressTime = now;
+            resources::ExtractionProgress currentProgress = progress;
+            currentProgress.files = extractedFiles;
+            currentProgress.bytes = extractedBytes;
+            progressHandler(currentProgress);
+        }
+    };
+
+    size_t threadCount = min({(size_t) max(thread::hardware_concurrency(), 1u),
+                            (size_t) NEU_EXTRACT_MAX_THREADS, files.size()});
+    vector<thread> workers;
+    for(size_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(extractFiles);
     }
-    return fs::readFile(settings::joinAppPath(filename));
+    extractFiles();
+    for(thread &worker: workers) {
+        worker.join();
+    }
+
+    if(progressHandler) {
+        progress.files = extractedFiles;
+        progress.bytes = extractedBytes;
+        progressHandler(progress);
+    }
+    return !failed;
+}
+
+// Asks the OS to read files of the bundle into the page cache in the background,
+// so the first reads of these files don't wait for the disk
+void prefetchFiles(const vector<string> &paths) {
+    #if !defined(_WIN32)
+    if(resources::isDirMode()) {
+        return;
+    }
+    uintptr_t pageMask = sysconf(_SC_PAGESIZE) - 1;
+    for(const string &path: paths) {
+        const resources::ResourceEntry *entry = resources::getEntry(path);
+        string_view data;
+        if(!entry || entry->isDirectory ||
+            !__viewBundleData(entry->offset, entry->compressedSize > 0 ? entry->compressedSize : entry->size, data) ||
+            data.empty()) {
+            continue;
+        }
+        uintptr_t start = (uintptr_t) data.data() & ~pageMask;
+        madvise((void *) start, (uintptr_t) data.data() + data.size() - start, MADV_WILLNEED);
+    }
+    #endif
+}
+
+// Returns a file of the resource bundle (bundle and embedded modes) without copying it
+resources::FileView getFileView(const string &filename, const fs::FileReaderOptions &fileReaderOptions) {
+    resources::FileView fileView;
+    if(resources::isDirMode()) {
+        fileView.status = errors::NE_RS_NOPATHE;
+        return fileView;
+    }
+    const resources::ResourceEntry *entry = resources::getEntry(filename);
+    if(!entry || entry->isDirectory) {
+        fileView.status = errors::NE_RS_NOPATHE;
+        return fileView;
+    }
+    return __getFileView(entry, fileReaderOptions);
+}
+
+fs::FileReaderResult getFile(const string &filename, const fs::FileReaderOptions &fileReaderOptions) {
+    if(resources::isDirMode()) {
+        return fs::readFile(settings::joinAppPath(filename), fileReaderOptions);
+    }
+    fs::FileReaderResult fileReaderResult;
+    resources::FileView fileView = resources::getFileView(filename, fileReaderOptions);
+    fileReaderResult.status = fileView.status;
+    if(fileView.buffer && fileView.data.size() == fileView.buffer->size()) {
+        fileReaderResult.data = move(*fileView.buffer);
+    }
+    else {
+        fileReaderResult.data.assign(fileView.data);
+    }
+    return fileReaderResult;
+}
+
+long long getFileSize(const string &filename) {
+    if(resources::isDirMode()) {
+        fs::FileStats fileStats = fs::getStats(settings::joinAppPath(filename));
+        if(fileStats.status != errors::NE_ST_OK || fileStats.entryType != fs::EntryTypeFile) {
+            return -1;
+        }
+        return fileStats.size;
+    }
+    const resources::ResourceEntry *entry = resources::getEntry(filename);
+    return entry && !entry->isDirectory ? (long long) entry->size : -1;
+}
+
+// Finds a file or directory of the bundle. Paths are matched without empty segments.
+const resources::ResourceEntry *getEntry(string_view path) {
+    // Paths are usually canonical already, so they are looked up without a copy
+    if(__isCanonicalPath(path)) {
+        return __findEntry(path);
+    }
+    string canonicalPath;
+    for(size_t start = 0; start < path.size();) {
+        size_t end = min(path.find('/', start), path.size());
+        if(end > start) {
+            canonicalPath.append("/").append(path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return __findEntry(canonicalPath.empty() ? "/" : canonicalPath);
+}
+
+// Returns the files and directories within a directory of the bundle in
+// depth-first order, or nothing if the path is not a directory
+vector<const resources::ResourceEntry *> getEntries(string_view path) {
+    vector<const resources::ResourceEntry *> subtree;
+    const resources::ResourceEntry *entry = resources::getEntry(path);
+    if(!entry || !entry->isDirectory) {
+        return subtree;
+    }
+    subtree.reserve(entry->subtreeSize);
+    for(size_t i = 1; i <= entry->subtreeSize; i++) {
+        subtree.push_back(entry + i);
+    }
+    return subtree;
 }
 
 void init() {
@@ -201,12 +565,12 @@ void init() {
         return;
     }
     if (resources::isEmbeddedMode()) {
-        if (postject_has_resource() && __makeEmbeddedFileTree()) {
+        if (postject_has_resource() && __findEmbeddedResources() && __makeFileIndex()) {
             return;
         }
         resources::setMode(resources::ResourceModeBundle); // Try bundle mode
     }
-    bool resourceLoaderStatus = __makeBundleFileTree();
+    bool resourceLoaderStatus = __mapResourceFile() && __makeFileIndex();
     if(!resourceLoaderStatus) {
         resources::setMode(resources::ResourceModeDir); // fallback to directory mode
     }
@@ -220,6 +584,33 @@ resources::ResourceMode getMode() {
     return mode;
 }
 
+// Checks whether the file is the mapped resources.neu. Truncating it would
+// break the mapping (or fail on Windows), so writes should replace the file instead.
+bool isMappedFile(const string &filename) {
+    #if defined(_WIN32)
+    if(!resourceFileMapped) {
+        return false;
+    }
+    HANDLE file = CreateFileW(CONVSTR(filename).c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION fileInfo;
+    bool mapped = GetFileInformationByHandle(file, &fileInfo) &&
+        fileInfo.dwVolumeSerialNumber == resourceFileInfo.dwVolumeSerialNumber &&
+        fileInfo.nFileIndexHigh == resourceFileInfo.nFileIndexHigh &&
+        fileInfo.nFileIndexLow == resourceFileInfo.nFileIndexLow;
+    CloseHandle(file);
+    return mapped;
+    #else
+    struct stat mappedStats, fileStats;
+    return resourceFile >= 0 && fstat(resourceFile, &mappedStats) == 0 &&
+        stat(filename.c_str(), &fileStats) == 0 &&
+        mappedStats.st_dev == fileStats.st_dev && mappedStats.st_ino == fileStats.st_ino;
+    #endif
+}
+
 bool isDirMode() {
    return resources::getMode() == resources::ResourceModeDir;
 }
@@ -232,10 +623,6 @@ bool isEmbeddedMode() {
    return resources::getMode() == resources::ResourceModeEmbedded;
 }
 
-json getFileTree() {
-   return fileTree;
-}
-
 string getModeString() {
     if (resources::isDirMode()) return "directory";
     else if (resources::isBundleMode()) return "bundle";
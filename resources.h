@@ -2,6 +2,11 @@
 #define NEU_RESOURCES_H
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <functional>
 
 #include "lib/json/json.hpp"
 #include "api/fs/fs.h"
@@ -13,8 +18,46 @@ namespace resources {
 
 enum ResourceMode { ResourceModeDir, ResourceModeBundle, ResourceModeEmbedded };
 
-fs::FileReaderResult getFile(const string &filename);
+// A file within the resource bundle. The data points into the mapped bundle,
+// which stays valid while the app runs, or into the buffer if the file was
+// decompressed.
+struct FileView {
+    errors::StatusCode status = errors::NE_ST_OK;
+    string_view data;
+    shared_ptr<string> buffer;
+};
+
+// A file or directory of the resource bundle. The subtree of a directory
+// follows it in the entry list.
+struct ResourceEntry {
+    string path;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    // Size within the bundle if the file is compressed, otherwise 0
+    uint64_t compressedSize = 0;
+    bool isDirectory = false;
+    size_t subtreeSize = 0;
+};
+
+struct ExtractionProgress {
+    uint64_t files = 0;
+    uint64_t totalFiles = 0;
+    uint64_t bytes = 0;
+    uint64_t totalBytes = 0;
+};
+
+typedef function<void(const resources::ExtractionProgress &)> ExtractionProgressHandler;
+
+resources::FileView getFileView(const string &filename, const fs::FileReaderOptions &fileReaderOptions = {});
+fs::FileReaderResult getFile(const string &filename, const fs::FileReaderOptions &fileReaderOptions = {});
+long long getFileSize(const string &filename);
+const resources::ResourceEntry *getEntry(string_view path);
+vector<const resources::ResourceEntry *> getEntries(string_view path);
+void prefetchFiles(const vector<string> &paths);
 bool extractFile(const string &filename, const string &outputFilename);
+bool extractDirectory(const string &path, const string &destination,
+    const resources::ExtractionProgressHandler &progressHandler = nullptr);
+bool isMappedFile(const string &filename);
 void init();
 void setMode(const resources::ResourceMode mode);
 resources::ResourceMode getMode();
@@ -22,7 +65,6 @@ bool isDirMode();
 bool isBundleMode();
 bool isEmbeddedMode();
 string getModeString();
-json getFileTree();
 
 } // namespace resources
 
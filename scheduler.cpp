@@ -0,0 +1,107 @@
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include <asio/io_context.hpp>
+#include <asio/executor_work_guard.hpp>
+#include <asio/post.hpp>
+
+#include "scheduler.h"
+
+using namespace std;
+
+/*
+* The reactor is the asio io_context that also runs the WebSocket server.
+* Timers are serialized on one strand, so callbacks should return quickly
+* and hand blocking work over to other threads.
+*/
+
+namespace scheduler {
+
+asio::io_context *ioContext = nullptr;
+asio::executor_work_guard<asio::io_context::executor_type> *workGuard = nullptr;
+scheduler::reactorStrand *timerStrand = nullptr;
+
+void __arm(const scheduler::TaskPtr &task) {
+    task->timer.async_wait([task](const asio::error_code &error) {
+        if(error || task->cancelled) {
+            return;
+        }
+        task->callback();
+        if(task->interval.count() > 0 && !task->cancelled) {
+            // Periodic tasks keep their rate, an overrun only delays the next run
+            auto nextExpiry = task->timer.expiry() + task->interval;
+            task->timer.expires_at(max(nextExpiry, chrono::steady_clock::now()));
+            __arm(task);
+        }
+    });
+}
+
+scheduler::TaskPtr __schedule(const function<void()> &callback, chrono::milliseconds delay,
+    chrono::milliseconds interval) {
+    scheduler::TaskPtr task = make_shared<scheduler::Task>(*timerStrand);
+    task->callback = callback;
+    task->interval = interval;
+    // Timers are not thread-safe, so they are only touched on the strand
+    asio::post(*timerStrand, [task, delay]() {
+        if(!task->cancelled) {
+            task->timer.expires_after(delay);
+            __arm(task);
+        }
+    });
+    return task;
+}
+
+void init() {
+    if(ioContext) {
+        return;
+    }
+    ioContext = new asio::io_context();
+    // Keeps the reactor threads running while there is nothing to do
+    workGuard = new asio::executor_work_guard<asio::io_context::executor_type>(ioContext->get_executor());
+    timerStrand = new scheduler::reactorStrand(asio::make_strand(ioContext->get_executor()));
+}
+
+asio::io_context *getIoContext() {
+    return ioContext;
+}
+
+// Runs the reactor on the calling thread, never returns
+void run() {
+    ioContext->run();
+}
+
+void startAsync() {
+    thread reactorThread([](){ ioContext->run(); });
+    reactorThread.detach();
+}
+
+bool isReactorThread() {
+    return ioContext && ioContext->get_executor().running_in_this_thread();
+}
+
+void post(const function<void()> &callback) {
+    asio::post(*ioContext, callback);
+}
+
+scheduler::TaskPtr setTimeout(const function<void()> &callback, chrono::milliseconds delay) {
+    return __schedule(callback, delay, chrono::milliseconds(0));
+}
+
+scheduler::TaskPtr setInterval(const function<void()> &callback, chrono::milliseconds interval) {
+    return __schedule(callback, interval, interval);
+}
+
+void cancel(const scheduler::TaskPtr &task) {
+    if(!task) {
+        return;
+    }
+    task->cancelled = true;
+    asio::post(*timerStrand, [task]() {
+        task->timer.cancel();
+    });
+}
+
+} // namespace scheduler
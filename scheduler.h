@@ -0,0 +1,43 @@
+#ifndef NEU_SCHEDULER_H
+#define NEU_SCHEDULER_H
+
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <atomic>
+
+#include <asio/io_context.hpp>
+#include <asio/strand.hpp>
+#include <asio/steady_timer.hpp>
+
+using namespace std;
+
+namespace scheduler {
+
+typedef asio::strand<asio::io_context::executor_type> reactorStrand;
+
+// A delayed or periodic task. Periodic tasks have a non-zero interval.
+struct Task {
+    asio::steady_timer timer;
+    chrono::milliseconds interval;
+    function<void()> callback;
+    atomic<bool> cancelled;
+
+    Task(const scheduler::reactorStrand &strand): timer(strand), interval(0), cancelled(false) {}
+};
+
+typedef shared_ptr<scheduler::Task> TaskPtr;
+
+void init();
+asio::io_context *getIoContext();
+void run();
+void startAsync();
+bool isReactorThread();
+void post(const function<void()> &callback);
+scheduler::TaskPtr setTimeout(const function<void()> &callback, chrono::milliseconds delay);
+scheduler::TaskPtr setInterval(const function<void()> &callback, chrono::milliseconds interval);
+void cancel(const scheduler::TaskPtr &task);
+
+} // namespace scheduler
+
+#endif // #define NEU_SCHEDULER_H
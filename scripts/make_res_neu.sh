@@ -2,6 +2,7 @@
 
 #
 # A script to build res.neu for the test app
+# Use --compress to build a compressed bundle with ./scripts/neupack.py
 #
 
 echo "Updating client..."
@@ -12,7 +13,11 @@ cd ./bin
 mkdir -p ./.res
 cp -r ./resources ./.res/
 cp ./neutralino.config.json ./.res/neutralino.config.json
-asar pack ./.res resources.neu
+if [ "$1" == "--compress" ]; then
+    python3 ../scripts/neupack.py ./.res resources.neu --compress
+else
+    asar pack ./.res resources.neu
+fi
 rm -r ./.res
 
 echo "Check resources.neu structure"
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+
+#
+# Packs a directory into resources.neu. With --compress, files are stored with
+# raw deflate and a preset dictionary shared by the whole bundle. The output is
+# still an asar archive, so asar list works, but only the framework reads the
+# compressed files.
+#
+
+import os
+import sys
+import json
+import zlib
+import struct
+import argparse
+from collections import Counter
+
+parser = argparse.ArgumentParser()
+parser.add_argument('source')
+parser.add_argument('output')
+parser.add_argument('--compress', action='store_true')
+parser.add_argument('--level', type=int, default=9)
+# The static server keeps a decompressed file in the asset cache, which takes files
+# up to a quarter of its size (default: 32 MB). Larger files are stored as they are,
+# so range requests (i.e., media seeking) don't decompress the whole file every time.
+parser.add_argument('--max-compressed-file-size', type=int, default=8388608)
+parser.add_argument('--verbose', action='store_true')
+args = parser.parse_args()
+
+BUNDLE_VERSION = 1
+# zlib only uses the last 32 KB of a preset dictionary
+DICTIONARY_SIZE = 32768
+DICTIONARY_SAMPLE_SIZE = 65536
+DICTIONARY_GRAM_SIZE = 32
+# Files that don't get at least this much smaller are stored as they are
+MIN_COMPRESSION_RATIO = 0.9
+MIN_COMPRESSED_FILE_SIZE = 128
+
+def log(msg):
+    if args.verbose:
+        print(msg)
+
+def list_files(source):
+    files = []
+    empty_dirs = []
+    for root, dirs, names in os.walk(source):
+        dirs.sort()
+        if root != source and not dirs and not names:
+            empty_dirs.append(os.path.relpath(root, source).replace(os.sep, '/'))
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            files.append(os.path.relpath(path, source).replace(os.sep, '/'))
+    return files, empty_dirs
+
+def build_dictionary(samples):
+    # Substrings that appear in many files are the most useful. zlib prefers
+    # matches near the end of the dictionary, so the most common ones go last.
+    counts = Counter()
+    for sample in samples:
+        grams = set()
+        for i in range(0, len(sample) - DICTIONARY_GRAM_SIZE + 1, DICTIONARY_GRAM_SIZE // 2):
+            grams.add(sample[i:i + DICTIONARY_GRAM_SIZE])
+        counts.update(grams)
+
+    grams = [gram for gram, count in counts.most_common() if count > 1]
+    grams = grams[:DICTIONARY_SIZE // DICTIONARY_GRAM_SIZE]
+    return b''.join(reversed(grams))
+
+def compress(data, dictionary):
+    if dictionary:
+        compressor = zlib.compressobj(args.level, zlib.DEFLATED, -15, 9, zlib.Z_DEFAULT_STRATEGY, dictionary)
+    else:
+        compressor = zlib.compressobj(args.level, zlib.DEFLATED, -15, 9)
+    return compressor.compress(data) + compressor.flush()
+
+def add_entry(tree, path, entry):
+    node = tree
+    for name in path.split('/')[:-1]:
+        node = node['files'].setdefault(name, {'files': {}})
+    node['files'][path.split('/')[-1]] = entry
+
+def pack():
+    paths, empty_dirs = list_files(args.source)
+    contents = {}
+    for path in paths:
+        with open(os.path.join(args.source, path), 'rb') as f:
+            contents[path] = f.read()
+
+    tree = {'files': {}}
+    blobs = []
+    offset = 0
+    dictionary = b''
+
+    if args.compress:
+        samples = [contents[path][:DICTIONARY_SAMPLE_SIZE] for path in paths
+                    if MIN_COMPRESSED_FILE_SIZE <= len(contents[path]) <= args.max_compressed_file_size]
+        dictionary = build_dictionary(samples)
+        tree['neuBundle'] = {
+            'version': BUNDLE_VERSION,
+            'compression': 'deflate',
+            'dictionary': {'offset': '0', 'size': len(dictionary)}
+        }
+        blobs.append(dictionary)
+        offset = len(dictionary)
+        log('Dictionary: %d bytes' % len(dictionary))
+
+    total_size = 0
+    for path in paths:
+        data = contents[path]
+        entry = {'size': len(data), 'offset': str(offset)}
+        if args.compress and MIN_COMPRESSED_FILE_SIZE <= len(data) <= args.max_compressed_file_size:
+            compressed = compress(data, dictionary)
+            if len(compressed) <= len(data) * MIN_COMPRESSION_RATIO:
+                entry['compressedSize'] = len(compressed)
+                data = compressed
+        add_entry(tree, path, entry)
+        blobs.append(data)
+        offset += len(data)
+        total_size += entry['size']
+        log('%s: %d -> %d' % (path, entry['size'], len(data)))
+
+    for path in empty_dirs:
+        add_entry(tree, path, {'files': {}})
+
+    # asar header: a pickle with the header size, then a pickle with the JSON header string
+    header = json.dumps(tree, separators=(',', ':')).encode()
+    padding = (4 - len(header) % 4) % 4
+    header_pickle = struct.pack('<I', len(header)) + header + b'\0' * padding
+    header_pickle = struct.pack('<I', len(header_pickle)) + header_pickle
+    size_pickle = struct.pack('<II', 4, len(header_pickle))
+
+    with open(args.output, 'wb') as f:
+        f.write(size_pickle)
+        f.write(header_pickle)
+        for blob in blobs:
+            f.write(blob)
+
+    print('Packed %d files: %d bytes -> %d bytes' % (len(paths), total_size, offset))
+
+if __name__ == '__main__':
+    if not os.path.isdir(args.source):
+        print('Source directory not found: %s' % args.source)
+        sys.exit(1)
+    pack()
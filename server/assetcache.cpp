@@ -0,0 +1,148 @@
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <ctime>
+#include <cstdio>
+
+#include "lib/json/json.hpp"
+#include "server/assetcache.h"
+#include "settings.h"
+
+#define NEU_DEFAULT_ASSET_CACHE_SIZE 33554432
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace assetcache {
+
+typedef pair<string, assetcache::AssetPtr> CacheEntry;
+
+list<assetcache::CacheEntry> entries; // Most recently used first
+unordered_map<string, list<assetcache::CacheEntry>::iterator> entryIndex;
+mutex entriesLock;
+size_t cacheSize = NEU_DEFAULT_ASSET_CACHE_SIZE;
+size_t usedSize = 0;
+
+// Strong validator: FNV-1a hash of the content and its length
+string __makeETag(string_view data) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for(const char c: data) {
+        hash ^= (unsigned char) c;
+        hash *= 1099511628211ULL;
+    }
+    char etag[48];
+    snprintf(etag, sizeof(etag), "\"%016llx-%llx\"", hash, (unsigned long long) data.size());
+    return string(etag);
+}
+
+string __makeHTTPDate(time_t time) {
+    tm gmtTime;
+    #if defined(_WIN32)
+    gmtime_s(&gmtTime, &time);
+    #else
+    gmtime_r(&time, &gmtTime);
+    #endif
+    char date[64];
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &gmtTime);
+    return string(date);
+}
+
+// Views of the mapped resource bundle only cost their metadata
+size_t __getCachedSize(const assetcache::AssetPtr &asset) {
+    return asset->storage.size();
+}
+
+void __removeEntry(list<assetcache::CacheEntry>::iterator it) {
+    usedSize -= __getCachedSize(it->second);
+    entryIndex.erase(it->first);
+    entries.erase(it);
+}
+
+void init() {
+    json jCacheSize = settings::getOptionForCurrentMode("assetCacheSize");
+    if(!jCacheSize.is_null() && jCacheSize.is_number_integer() && jCacheSize.get<long long>() >= 0) {
+        lock_guard<mutex> guard(entriesLock);
+        cacheSize = jCacheSize.get<size_t>();
+    }
+}
+
+// Formats a modification time in milliseconds as an HTTP date. Assets without
+// one (i.e., bundle assets) are dated by when they were cached.
+string makeLastModified(long long modifiedAt) {
+    return __makeHTTPDate(modifiedAt > 0 ? (time_t) (modifiedAt / 1000) : time(nullptr));
+}
+
+void __initAsset(assetcache::Asset &asset, long long modifiedAt) {
+    asset.etag = __makeETag(asset.data);
+    asset.modifiedAt = modifiedAt;
+    asset.size = asset.data.size();
+    asset.lastModified = assetcache::makeLastModified(modifiedAt);
+}
+
+assetcache::AssetPtr makeAsset(string &&data, long long modifiedAt) {
+    shared_ptr<assetcache::Asset> asset = make_shared<assetcache::Asset>();
+    asset->storage = move(data);
+    asset->data = asset->storage;
+    __initAsset(*asset, modifiedAt);
+    return asset;
+}
+
+// The asset doesn't own the data, so the data should outlive the asset
+assetcache::AssetPtr makeAssetView(string_view data, long long modifiedAt) {
+    shared_ptr<assetcache::Asset> asset = make_shared<assetcache::Asset>();
+    asset->data = data;
+    __initAsset(*asset, modifiedAt);
+    return asset;
+}
+
+assetcache::AssetPtr get(const string &key) {
+    lock_guard<mutex> guard(entriesLock);
+    auto it = entryIndex.find(key);
+    if(it == entryIndex.end()) {
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+void put(const string &key, const assetcache::AssetPtr &asset) {
+    lock_guard<mutex> guard(entriesLock);
+    auto it = entryIndex.find(key);
+    if(it != entryIndex.end()) {
+        __removeEntry(it->second);
+    }
+    size_t assetSize = __getCachedSize(asset);
+    if(!assetcache::isCacheable(assetSize)) {
+        return;
+    }
+    while(usedSize + assetSize > cacheSize && !entries.empty()) {
+        __removeEntry(prev(entries.end()));
+    }
+    entries.emplace_front(key, asset);
+    entryIndex[key] = entries.begin();
+    usedSize += assetSize;
+}
+
+// Large files would evict the whole cache, so they are not kept
+bool isCacheable(long long size) {
+    return size >= 0 && (size_t) size <= cacheSize / 4;
+}
+
+void remove(const string &key) {
+    lock_guard<mutex> guard(entriesLock);
+    auto it = entryIndex.find(key);
+    if(it != entryIndex.end()) {
+        __removeEntry(it->second);
+    }
+}
+
+void clear() {
+    lock_guard<mutex> guard(entriesLock);
+    entries.clear();
+    entryIndex.clear();
+    usedSize = 0;
+}
+
+} // namespace assetcache
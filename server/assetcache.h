@@ -0,0 +1,37 @@
+#ifndef NEU_ASSETCACHE_H
+#define NEU_ASSETCACHE_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+
+using namespace std;
+
+namespace assetcache {
+
+struct Asset {
+    // Points to storage, or to the mapped resource bundle for bundle assets
+    string_view data;
+    string storage;
+    string etag;
+    string lastModified;
+    // Disk-backed assets are validated against these stats on every hit
+    long long modifiedAt = 0;
+    long long size = 0;
+};
+
+typedef shared_ptr<const assetcache::Asset> AssetPtr;
+
+void init();
+assetcache::AssetPtr makeAsset(string &&data, long long modifiedAt);
+assetcache::AssetPtr makeAssetView(string_view data, long long modifiedAt);
+assetcache::AssetPtr get(const string &key);
+void put(const string &key, const assetcache::AssetPtr &asset);
+void remove(const string &key);
+bool isCacheable(long long size);
+void clear();
+string makeLastModified(long long modifiedAt);
+
+} // namespace assetcache
+
+#endif // #define NEU_ASSETCACHE_H
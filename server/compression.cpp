@@ -0,0 +1,70 @@
+#include <string>
+
+#if defined(NEU_HAS_ZLIB)
+#include <zlib.h>
+#endif
+
+#include "server/compression.h"
+
+using namespace std;
+
+namespace compression {
+
+bool isGzipAvailable() {
+    #if defined(NEU_HAS_ZLIB)
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+bool gzip(string_view data, string &output, int level) {
+    #if defined(NEU_HAS_ZLIB)
+    z_stream stream = {};
+    // 15 window bits + 16 writes a gzip header instead of the zlib one
+    if(deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    output.resize(deflateBound(&stream, data.size()));
+    stream.next_in = (Bytef *) data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *) output.data();
+    stream.avail_out = output.size();
+    int status = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return status == Z_STREAM_END;
+    #else
+    return false;
+    #endif
+}
+
+// Inflates raw deflate data (i.e., a compressed resource bundle file) of a
+// known size that was compressed with the given preset dictionary
+bool inflateRaw(string_view data, string_view dictionary, size_t size, string &output) {
+    #if defined(NEU_HAS_ZLIB)
+    z_stream stream = {};
+    // Negative window bits read raw deflate data without a header
+    if(inflateInit2(&stream, -15) != Z_OK) {
+        return false;
+    }
+    if(!dictionary.empty() &&
+        inflateSetDictionary(&stream, (const Bytef *) dictionary.data(), dictionary.size()) != Z_OK) {
+        inflateEnd(&stream);
+        return false;
+    }
+    output.resize(size);
+    stream.next_in = (Bytef *) data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *) output.data();
+    stream.avail_out = output.size();
+    int status = inflate(&stream, Z_FINISH);
+    bool complete = status == Z_STREAM_END && stream.total_out == size;
+    inflateEnd(&stream);
+    return complete;
+    #else
+    return false;
+    #endif
+}
+
+} // namespace compression
@@ -0,0 +1,17 @@
+#ifndef NEU_COMPRESSION_H
+#define NEU_COMPRESSION_H
+
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace compression {
+
+bool isGzipAvailable();
+bool gzip(string_view data, string &output, int level = 6);
+bool inflateRaw(string_view data, string_view dictionary, size_t size, string &output);
+
+} // namespace compression
+
+#endif // #define NEU_COMPRESSION_H
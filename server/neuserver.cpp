@@ -1,49 +1,135 @@
 #include <iostream>
 #include <cstdlib>
 #include <string>
-#include <regex>
+#include <fstream>
 #include <map>
 #include <thread>
 #include <chrono>
 #include <set>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <functional>
 
-#include <websocketpp/config/asio_no_tls.hpp>
-#include <websocketpp/server.hpp>
+#include <asio/thread_pool.hpp>
+#include <asio/strand.hpp>
+#include <asio/post.hpp>
 
 #include "lib/json/json.hpp"
 #include "settings.h"
+#include "scheduler.h"
 #include "helpers.h"
 #include "errors.h"
 #include "extensions_loader.h"
 #include "server/neuserver.h"
 #include "server/router.h"
+#include "server/urlparser.h"
+#include "server/wsconfig.h"
+#include "server/sendqueue.h"
 #include "auth/authbasic.h"
 #include "api/debug/debug.h"
 #include "api/events/events.h"
 #include "api/app/app.h"
+#include "api/os/processreactor.h"
 
 using namespace std;
 using json = nlohmann::json;
 
-typedef websocketpp::server<websocketpp::config::asio> websocketserver;
 typedef map<string, websocketpp::connection_hdl> wsclientsMap;
 typedef set<websocketpp::connection_hdl, owner_less<websocketpp::connection_hdl>> wsclientsSet;
+typedef asio::strand<asio::thread_pool::executor_type> nativeStrand;
+
+namespace neuserver {
+
+enum MessageFormat { MessageFormatJSON, MessageFormatCBOR, MessageFormatMsgPack };
+enum BroadcastScope { BroadcastScopeAll, BroadcastScopeApps, BroadcastScopeExtensions };
+
+struct ClientState {
+    shared_ptr<nativeStrand> strand;
+    neuserver::MessageFormat format = neuserver::MessageFormatJSON;
+    bool compressed = false;
+    bool extension = false;
+    string extensionId;
+    // Connections receive all events until they subscribe to specific ones
+    bool filtered = false;
+    set<string> topics;
+    sendqueue::QueuePtr queue;
+};
+
+} // namespace neuserver
+
+typedef map<websocketpp::connection_hdl, neuserver::ClientState, owner_less<websocketpp::connection_hdl>> wsclientStatesMap;
+
+namespace neuserver {
+
+// An immutable snapshot of the connected clients. Connects, disconnects, and
+// subscription changes copy the current snapshot and publish the new one,
+// so broadcasts from other threads read a consistent registry without a lock.
+struct Registry {
+    wsclientStatesMap clientStates;
+    wsclientsSet appConnections;
+    wsclientsMap extConnections;
+    // Event subscription index, so broadcasts only visit interested connections.
+    // Topics ending with '*' are stored by their prefix in wildcardSubscribers.
+    wsclientsSet unfilteredClients;
+    map<string, wsclientsSet> topicSubscribers;
+    map<string, wsclientsSet> wildcardSubscribers;
+};
+
+typedef shared_ptr<const neuserver::Registry> RegistryPtr;
+
+} // namespace neuserver
+
+#define NEU_DEFAULT_SERVER_THREADS 1
+#define NEU_DEFAULT_NATIVE_WORKER_THREADS 4
+#define NEU_DEFAULT_WS_COMPRESSION_THRESHOLD 1024
+#define NEU_SUBSCRIBE_METHOD "subscribe"
+#define NEU_SEND_QUEUE_WATERMARK 65536
+#define NEU_SEND_QUEUE_FLUSH_INTERVAL 5
+#define NEU_UNSUBSCRIBE_METHOD "unsubscribe"
 
 namespace neuserver {
 
 websocketserver *server;
-wsclientsSet appConnections;
-wsclientsMap extConnections;
+neuserver::RegistryPtr activeRegistry = make_shared<const neuserver::Registry>();
+// Only serializes registry updates, readers never take it
+mutex registryLock;
+
+// Native methods run on a separate worker pool, so slow calls don't block
+// the I/O threads. Each connection gets a strand to keep its calls in order.
+asio::thread_pool *nativeWorkers = nullptr;
 
 bool initialized = false;
 bool applyConfigHeaders = false;
+size_t wsCompressionThreshold = NEU_DEFAULT_WS_COMPRESSION_THRESHOLD;
+
+// Events wait in per-connection send queues while websocketpp's own buffer
+// is full. A scheduler task hands them over as clients catch up.
+atomic<bool> flushScheduled(false);
+scheduler::TaskPtr idleExitTask;
+
+neuserver::RegistryPtr __getRegistry() {
+    return atomic_load(&activeRegistry);
+}
+
+// Applies the update to a copy of the registry and publishes the copy.
+// Readers keep using the snapshot they loaded until they are done with it.
+neuserver::RegistryPtr __updateRegistry(const function<void(neuserver::Registry &)> &update) {
+    lock_guard<mutex> guard(registryLock);
+    shared_ptr<neuserver::Registry> nextRegistry = make_shared<neuserver::Registry>(*atomic_load(&activeRegistry));
+    update(*nextRegistry);
+    neuserver::RegistryPtr published = nextRegistry;
+    atomic_store(&activeRegistry, published);
+    return published;
+}
 
 bool __isExtensionEndpoint(const string &url) {
-    return regex_match(url, regex(".*extensionId=.*"));
+    return urlparser::hasQueryParam(url, "extensionId");
 }
 
 bool __hasConnectToken(const string &url) {
-    return regex_match(url, regex(".*connectToken=.*"));
+    return urlparser::hasQueryParam(url, "connectToken");
 }
 
 void __applyConfigHeaders(websocketserver::connection_ptr con) {
@@ -54,14 +140,14 @@ void __applyConfigHeaders(websocketserver::connection_ptr con) {
 }
 
 string __getParamValueFromUrl(const string &url, const string &param) {
-    string val = "";
-    smatch matches;
-    if(regex_search(url, matches, regex(param + "=([\\w.\\-_]+)"))) {
-        if(matches.size() >= 2) {
-            val = matches[1].str();
-        }
+    string_view val = urlparser::getQueryParam(url, param).value_or("");
+    // Extension ids and connect tokens only contain word characters, dots, and dashes
+    size_t validLength = 0;
+    while(validLength < val.size() && (isalnum((unsigned char) val[validLength])
+        || val[validLength] == '_' || val[validLength] == '.' || val[validLength] == '-')) {
+        validLength++;
     }
-    return val;
+    return string(val.substr(0, validLength));
 }
 
 string __getExtensionIdFromUrl(const string &url) {
@@ -72,14 +158,369 @@ string __getConnectTokenFromUrl(const string &url) {
     return __getParamValueFromUrl(url, "connectToken");
 }
 
+// Clients can opt in to binary native messages with the protocol query param
+neuserver::MessageFormat __getMessageFormatFromUrl(const string &url) {
+    string protocol = __getParamValueFromUrl(url, "protocol");
+    if(protocol == "cbor") return neuserver::MessageFormatCBOR;
+    if(protocol == "msgpack") return neuserver::MessageFormatMsgPack;
+    return neuserver::MessageFormatJSON;
+}
+
+// Binary formats keep binary values (i.e., file contents) as raw byte strings
+string __serializeMessage(const json &message, neuserver::MessageFormat format) {
+    if(format == neuserver::MessageFormatCBOR) {
+        vector<uint8_t> data = json::to_cbor(message);
+        return string(data.begin(), data.end());
+    }
+    if(format == neuserver::MessageFormatMsgPack) {
+        vector<uint8_t> data = json::to_msgpack(message);
+        return string(data.begin(), data.end());
+    }
+    return helpers::jsonToString(message);
+}
+
+json __parseMessage(const string &payload, websocketpp::frame::opcode::value opcode,
+    neuserver::MessageFormat format) {
+    if(opcode == websocketpp::frame::opcode::binary) {
+        if(format == neuserver::MessageFormatMsgPack) {
+            return json::from_msgpack(payload);
+        }
+        return json::from_cbor(payload);
+    }
+    return json::parse(payload);
+}
+
+websocketpp::frame::opcode::value __getOpcode(neuserver::MessageFormat format) {
+    return format == neuserver::MessageFormatJSON ? websocketpp::frame::opcode::text :
+            websocketpp::frame::opcode::binary;
+}
+
+// Messages are deflated only if the client negotiated permessage-deflate,
+// and small ones are sent raw since compressing them costs more than it saves
+websocketpp::lib::error_code __send(websocketserver::connection_ptr con, const string &payload,
+    websocketpp::frame::opcode::value opcode) {
+    websocketserver::message_ptr msg = con->get_message(opcode, payload.size());
+    msg->append_payload(payload);
+    msg->set_compressed(payload.size() >= wsCompressionThreshold);
+    return con->send(msg);
+}
+
+void __send(websocketpp::connection_hdl handler, const string &payload,
+    websocketpp::frame::opcode::value opcode, websocketpp::lib::error_code &ec) {
+    websocketserver::connection_ptr con = server->get_con_from_hdl(handler, ec);
+    if(ec) {
+        return;
+    }
+    ec = __send(con, payload, opcode);
+}
+
+// Frames a message once, so the same buffer is queued on every recipient
+// instead of copying and framing the payload per connection
+websocketserver::message_ptr __prepareMessage(string payload, websocketpp::frame::opcode::value opcode) {
+    websocketserver::message_ptr msg = make_shared<wsconfig::asio::message_type>(nullptr, opcode, 0);
+    websocketpp::frame::basic_header header(opcode, payload.size(), true, false);
+    websocketpp::frame::extended_header extendedHeader(payload.size());
+    msg->set_header(websocketpp::frame::prepare_header(header, extendedHeader));
+    msg->get_raw_payload() = move(payload);
+    msg->set_prepared(true);
+    return msg;
+}
+
+websocketpp::lib::error_code __sendPrepared(websocketserver::connection_ptr con,
+    const websocketserver::message_ptr &msg, bool compressed) {
+    // Deflate connections compress large messages with their own zlib streams
+    if(compressed && msg->get_payload().size() >= wsCompressionThreshold) {
+        return __send(con, msg->get_payload(), msg->get_opcode());
+    }
+    return con->send(msg);
+}
+
+string __getEventName(const json &message) {
+    if(message.is_object() && message.contains("event") && message["event"].is_string()) {
+        return message["event"].get<string>();
+    }
+    return "";
+}
+
+struct Recipient {
+    websocketpp::connection_hdl connection;
+    neuserver::MessageFormat format;
+    bool compressed;
+    sendqueue::QueuePtr queue;
+};
+
+typedef vector<neuserver::Recipient> wsclientsList;
+
+bool __hasSendCapacity(websocketserver::connection_ptr con) {
+    return con->get_buffered_amount() < NEU_SEND_QUEUE_WATERMARK;
+}
+
+// Flushes all send queues, returns true if events are still waiting
+bool __flushQueues() {
+    neuserver::RegistryPtr clients = __getRegistry();
+    bool pending = false;
+    for(const auto &[connection, clientState]: clients->clientStates) {
+        websocketpp::lib::error_code ec;
+        websocketserver::connection_ptr con = server->get_con_from_hdl(connection, ec);
+        if(ec || !clientState.queue) {
+            continue;
+        }
+        bool compressed = clientState.compressed;
+        pending = sendqueue::flush(clientState.queue, [&]() { return __hasSendCapacity(con); },
+            [&](const websocketserver::message_ptr &msg) {
+                __sendPrepared(con, msg, compressed);
+            }) || pending;
+    }
+    return pending;
+}
+
+void __scheduleFlush() {
+    if(flushScheduled.exchange(true)) {
+        return;
+    }
+    scheduler::setTimeout([]() {
+        flushScheduled = false;
+        if(__flushQueues()) {
+            __scheduleFlush();
+        }
+    }, chrono::milliseconds(NEU_SEND_QUEUE_FLUSH_INTERVAL));
+}
+
+// Sends a message to many clients by serializing and framing it once per format.
+// Events go through the send queue of each connection.
+bool __sendToClients(const wsclientsList &clients, json &&message) {
+    map<neuserver::MessageFormat, websocketserver::message_ptr> messages;
+    string event = __getEventName(message);
+    shared_ptr<const json> content = make_shared<const json>(move(message));
+    // Blocking the I/O threads would also stop the queues from draining, and
+    // blocking the process reactor would stall the output of all processes
+    bool canBlock = !server->get_io_service().get_executor().running_in_this_thread() &&
+            !processreactor::isReactorThread() && sendqueue::isBlocking(sendqueue::getPolicy(event));
+    vector<sendqueue::QueuePtr> waitingQueues;
+    bool sent = true;
+    for(const neuserver::Recipient &recipient: clients) {
+        websocketserver::message_ptr &msg = messages[recipient.format];
+        if(!msg) {
+            msg = __prepareMessage(__serializeMessage(*content, recipient.format),
+                    __getOpcode(recipient.format));
+        }
+        websocketpp::lib::error_code ec;
+        websocketserver::connection_ptr con = server->get_con_from_hdl(recipient.connection, ec);
+        if(!ec && (event.empty() || !recipient.queue)) {
+            ec = __sendPrepared(con, msg, recipient.compressed);
+        }
+        else if(!ec) {
+            sendqueue::Message queuedMessage;
+            queuedMessage.event = event;
+            queuedMessage.content = content;
+            queuedMessage.frame = msg;
+            bool queued = sendqueue::push(recipient.queue, move(queuedMessage),
+                [&]() { return __hasSendCapacity(con); },
+                [&](const websocketserver::message_ptr &queuedMsg) {
+                    ec = __sendPrepared(con, queuedMsg, recipient.compressed);
+                });
+            if(queued) {
+                __scheduleFlush();
+                if(canBlock) {
+                    waitingQueues.push_back(recipient.queue);
+                }
+            }
+        }
+        sent = sent && !ec;
+    }
+    // Every recipient has the event before the producer waits for slow ones
+    if(!waitingQueues.empty()) {
+        sendqueue::waitForCapacity(waitingQueues);
+    }
+    return sent;
+}
+
+bool __isWildcardTopic(const string &topic) {
+    return !topic.empty() && topic.back() == '*';
+}
+
+bool __isSubscribed(const neuserver::ClientState &clientState, const string &event) {
+    if(!clientState.filtered || event.empty()) {
+        return true;
+    }
+    for(const string &topic: clientState.topics) {
+        if(topic == event || (__isWildcardTopic(topic) &&
+            helpers::startsWith(event, topic.substr(0, topic.size() - 1)))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool __isInScope(const neuserver::ClientState &clientState, neuserver::BroadcastScope scope) {
+    return scope == neuserver::BroadcastScopeAll ||
+            (scope == neuserver::BroadcastScopeExtensions) == clientState.extension;
+}
+
+void __addClients(const neuserver::Registry &registry, wsclientsSet &recipients, const wsclientsSet &clients,
+    neuserver::BroadcastScope scope) {
+    for(const auto &connection: clients) {
+        auto it = registry.clientStates.find(connection);
+        if(it != registry.clientStates.end() && __isInScope(it->second, scope)) {
+            recipients.insert(connection);
+        }
+    }
+}
+
+// Collects the connections that listen for the event. Messages that are not
+// events (i.e., without the event field) go to every connection in the scope.
+void __addSubscribers(const neuserver::Registry &registry, wsclientsList &clients, const string &event,
+    neuserver::BroadcastScope scope) {
+    wsclientsSet recipients;
+    if(event.empty()) {
+        for(const auto &[connection, clientState]: registry.clientStates) {
+            if(__isInScope(clientState, scope)) {
+                recipients.insert(connection);
+            }
+        }
+    }
+    else {
+        __addClients(registry, recipients, registry.unfilteredClients, scope);
+        auto it = registry.topicSubscribers.find(event);
+        if(it != registry.topicSubscribers.end()) {
+            __addClients(registry, recipients, it->second, scope);
+        }
+        for(const auto &[prefix, subscribers]: registry.wildcardSubscribers) {
+            if(helpers::startsWith(event, prefix)) {
+                __addClients(registry, recipients, subscribers, scope);
+            }
+        }
+    }
+    for(const auto &connection: recipients) {
+        const neuserver::ClientState &clientState = registry.clientStates.at(connection);
+        clients.push_back({connection, clientState.format, clientState.compressed, clientState.queue});
+    }
+}
+
+void __indexTopic(neuserver::Registry &registry, websocketpp::connection_hdl handler, const string &topic,
+    bool subscribe) {
+    map<string, wsclientsSet> &index = __isWildcardTopic(topic) ? registry.wildcardSubscribers :
+            registry.topicSubscribers;
+    string key = __isWildcardTopic(topic) ? topic.substr(0, topic.size() - 1) : topic;
+    if(subscribe) {
+        index[key].insert(handler);
+        return;
+    }
+    auto it = index.find(key);
+    if(it != index.end()) {
+        it->second.erase(handler);
+        if(it->second.empty()) {
+            index.erase(it);
+        }
+    }
+}
+
+void __removeSubscriptions(neuserver::Registry &registry, websocketpp::connection_hdl handler,
+    neuserver::ClientState &clientState) {
+    registry.unfilteredClients.erase(handler);
+    for(const string &topic: clientState.topics) {
+        __indexTopic(registry, handler, topic, false);
+    }
+    clientState.topics.clear();
+}
+
+// Handles the subscribe and unsubscribe protocol messages. Once a connection
+// subscribes, it only receives the events it subscribed to.
+router::NativeMessage __updateSubscriptions(websocketpp::connection_hdl handler, const router::NativeMessage &request) {
+    router::NativeMessage response = {request.id, request.method, "", json(), request.connection};
+    if(!authbasic::verifyToken(request.accessToken)) {
+        response.data["error"] = errors::makeErrorPayload(errors::NE_RT_INVTOKN);
+        return response;
+    }
+    if(!helpers::hasRequiredFields(request.data, {"events"}) || !request.data["events"].is_array()) {
+        response.data["error"] = errors::makeMissingArgErrorPayload("events");
+        return response;
+    }
+    bool subscribe = request.method == NEU_SUBSCRIBE_METHOD;
+
+    bool connected = false;
+    __updateRegistry([&](neuserver::Registry &registry) {
+        auto it = registry.clientStates.find(handler);
+        if(it == registry.clientStates.end()) {
+            return;
+        }
+        connected = true;
+        neuserver::ClientState &clientState = it->second;
+        // Unsubscribing from an unfiltered connection doesn't filter it
+        if(subscribe && !clientState.filtered) {
+            clientState.filtered = true;
+            registry.unfilteredClients.erase(handler);
+        }
+        for(const json &jEvent: request.data["events"]) {
+            if(!jEvent.is_string() || jEvent.get<string>().empty()) {
+                continue;
+            }
+            string topic = jEvent.get<string>();
+            bool subscribed = clientState.topics.find(topic) != clientState.topics.end();
+            if(subscribe == subscribed) {
+                continue;
+            }
+            if(subscribe) {
+                clientState.topics.insert(topic);
+            }
+            else {
+                clientState.topics.erase(topic);
+            }
+            __indexTopic(registry, handler, topic, subscribe);
+        }
+        response.data["returnValue"] = clientState.topics;
+    });
+    if(!connected) {
+        response.data["error"] = errors::makeErrorPayload(errors::NE_SR_UNBSEND);
+        return response;
+    }
+    response.data["success"] = true;
+    return response;
+}
+
+// Only the last disconnect in a burst (i.e., a page reload) checks for idle
 void __exitProcessIfIdle() {
-    thread exitCheckThread([=]() {
-        std::this_thread::sleep_for(10s);
-        if(appConnections.size() == 0) {
+    scheduler::TaskPtr task = scheduler::setTimeout([]() {
+        if(__getRegistry()->appConnections.empty()) {
             app::exit();
         }
-    });
-    exitCheckThread.detach();
+    }, 10s);
+    scheduler::cancel(atomic_exchange(&idleExitTask, task));
+}
+
+int __getThreadCountOption(const string &key, int defaultValue) {
+    json jThreads = settings::getOptionForCurrentMode(key);
+    if(!jThreads.is_null() && jThreads.is_number_integer() && jThreads.get<int>() >= 0) {
+        return jThreads.get<int>();
+    }
+    return defaultValue;
+}
+
+void __sendNativeResponse(websocketpp::connection_hdl handler, const router::NativeMessage &nativeResponse,
+    neuserver::MessageFormat format) {
+    json nativeMessage;
+    nativeMessage["id"] = nativeResponse.id;
+    nativeMessage["method"] = nativeResponse.method;
+    nativeMessage["data"] = nativeResponse.data;
+
+    websocketpp::lib::error_code ec;
+    __send(handler, __serializeMessage(nativeMessage, format), __getOpcode(format), ec);
+    if(ec) {
+        debug::log(debug::LogTypeError, errors::makeErrorMsg(errors::NE_SR_UNBSEND));
+    }
+}
+
+// permessage-deflate is opt-in since it keeps zlib streams for every connection
+void __initCompression() {
+    #if defined(NEU_HAS_ZLIB)
+    json jCompression = settings::getOptionForCurrentMode("wsCompression");
+    wsconfig::deflateExtension::negotiable = jCompression.is_boolean() && jCompression.get<bool>();
+    #endif
+
+    json jThreshold = settings::getOptionForCurrentMode("wsCompressionThreshold");
+    if(jThreshold.is_number_integer() && jThreshold.get<int>() >= 0) {
+        wsCompressionThreshold = jThreshold.get<int>();
+    }
 }
 
 string init() {
@@ -88,6 +529,7 @@ string init() {
     if(!jPort.is_null()) {
         port = jPort.get<int>();
     }
+    __initCompression();
     server = new websocketserver();
 
     server->set_message_handler([&](websocketpp::connection_hdl handler, websocketserver::message_ptr msg) {
@@ -113,7 +555,9 @@ string init() {
     server->set_access_channels(websocketpp::log::alevel::none);
     server->set_error_channels(websocketpp::log::elevel::none);
 
-    server->init_asio();
+    // The server shares the scheduler's reactor, so timers run on the I/O threads
+    server->init_asio(scheduler::getIoContext());
+    sendqueue::init();
     server->set_reuse_addr(true);
 
     string hostAddress = "127.0.0.1";
@@ -139,7 +583,7 @@ string init() {
 
     if(!jUrl.is_null()) {
         string url = jUrl.get<string>();
-        if (regex_match(url, regex("^/.*")))
+        if (helpers::startsWith(url, "/"))
             navigationUrl += url;
         else
             navigationUrl = url;
@@ -151,6 +595,11 @@ string init() {
         applyConfigHeaders = true;
     }
 
+    int nativeWorkerThreads = __getThreadCountOption("nativeWorkerThreads", NEU_DEFAULT_NATIVE_WORKER_THREADS);
+    if(nativeWorkerThreads > 0) {
+        nativeWorkers = new asio::thread_pool(nativeWorkerThreads);
+    }
+
     return navigationUrl;
 }
 
@@ -159,8 +608,11 @@ bool isInitialized() {
 }
 
 void startAsync() {
-    thread serverThread([&](){ server->run(); });
-    serverThread.detach();
+    int serverThreads = max(__getThreadCountOption("serverThreads", NEU_DEFAULT_SERVER_THREADS), 1);
+    for(int i = 0; i < serverThreads; i++) {
+        thread serverThread([&](){ server->run(); });
+        serverThread.detach();
+    }
 }
 
 void stop() {
@@ -170,30 +622,84 @@ void stop() {
 void handleMessage(websocketpp::connection_hdl handler, websocketserver::message_ptr msg) {
     json nativeMessage;
     try {
-        nativeMessage = json::parse(msg->get_payload());
-        router::NativeMessage nativeResponse = router::executeNativeMethod({
+        shared_ptr<nativeStrand> strand;
+        neuserver::MessageFormat format = neuserver::MessageFormatJSON;
+        {
+            neuserver::RegistryPtr clients = __getRegistry();
+            auto it = clients->clientStates.find(handler);
+            if(it != clients->clientStates.end()) {
+                strand = it->second.strand;
+                format = it->second.format;
+            }
+        }
+
+        nativeMessage = __parseMessage(msg->get_payload(), msg->get_opcode(), format);
+        router::NativeMessage nativeRequest = {
             nativeMessage["id"].get<string>(),
             nativeMessage["method"].get<string>(),
             nativeMessage["accessToken"].get<string>(),
-            nativeMessage["data"]
-        });
+            nativeMessage["data"],
+            handler
+        };
+        // Text requests get text responses, so clients can always fall back to JSON
+        if(msg->get_opcode() == websocketpp::frame::opcode::text) {
+            format = neuserver::MessageFormatJSON;
+        }
+        auto responseHandler = [=](const router::NativeMessage &nativeResponse) {
+            __sendNativeResponse(handler, nativeResponse, format);
+        };
+
+        // Subscription changes keep their order with the connection's other calls
+        if(nativeRequest.method == NEU_SUBSCRIBE_METHOD || nativeRequest.method == NEU_UNSUBSCRIBE_METHOD) {
+            auto updateSubscriptions = [=]() {
+                responseHandler(__updateSubscriptions(handler, nativeRequest));
+            };
+            if(strand) {
+                asio::post(*strand, updateSubscriptions);
+            }
+            else {
+                updateSubscriptions();
+            }
+            return;
+        }
 
-        try {
-            json nativeMessage;
-            nativeMessage["id"] = nativeResponse.id;
-            nativeMessage["method"] = nativeResponse.method;
-            nativeMessage["data"] = nativeResponse.data;
+        // Long-running methods don't hold the connection's queue,
+        // their responses are matched with requests by the message id
+        if(nativeWorkers && router::isAsyncRequest(nativeRequest)) {
+            asio::post(*nativeWorkers, [=]() {
+                router::executeNativeMethod(nativeRequest, responseHandler);
+            });
+            return;
+        }
 
-            server->send(handler, helpers::jsonToString(nativeMessage), msg->get_opcode());
-        } catch (websocketpp::exception const & e) {
-            debug::log(debug::LogTypeError, errors::makeErrorMsg(errors::NE_SR_UNBSEND));
+        if(!strand) {
+            router::executeNativeMethod(nativeRequest, responseHandler);
+            return;
         }
+
+        asio::post(*strand, [=]() {
+            router::executeNativeMethod(nativeRequest, responseHandler);
+        });
     }
     catch(const exception& e) {
         debug::log(debug::LogTypeError, errors::makeErrorMsg(errors::NE_SR_UNBPARS));
     }
 }
 
+// Large files are sent in parts from the disk on the I/O thread
+bool __setBodyReader(const websocketserver::connection_ptr &con, router::Response &routerResponse) {
+    auto reader = make_shared<ifstream>(CONVSTR(routerResponse.bodyFilename), ios::binary);
+    if(!reader->is_open()) {
+        routerResponse.bodyFilename.clear();
+        return false;
+    }
+    con->set_body_reader(routerResponse.bodySize, [reader](char *buffer, size_t size) -> size_t {
+        reader->read(buffer, size);
+        return reader->gcount();
+    });
+    return true;
+}
+
 void handleHTTP(websocketpp::connection_hdl handler) {
     websocketserver::connection_ptr con = server->get_con_from_hdl(handler);
     string resource = con->get_resource();
@@ -201,10 +707,26 @@ void handleHTTP(websocketpp::connection_hdl handler) {
     if(!documentRoot.empty()) {
         resource = documentRoot + resource;
     }
-    router::Response routerResponse = router::serve(resource);
+    router::Response routerResponse = router::serve(resource, con->get_request());
+    if(!routerResponse.bodyFilename.empty() && !__setBodyReader(con, routerResponse)) {
+        routerResponse.status = websocketpp::http::status_code::not_found;
+        routerResponse.headers.clear();
+    }
     con->set_status(routerResponse.status);
-    con->set_body(routerResponse.data);
+    // Streamed bodies are read from the file while they are sent
+    if(routerResponse.bodyFilename.empty() && routerResponse.status != websocketpp::http::status_code::not_modified) {
+        // The body is moved into the response, so viewed assets are copied only once
+        if(!routerResponse.dataView.empty()) {
+            con->set_body(string(routerResponse.dataView));
+        }
+        else {
+            con->set_body(move(routerResponse.data));
+        }
+    }
     con->replace_header("Content-Type", routerResponse.contentType);
+    for(const auto &[header, value]: routerResponse.headers) {
+        con->replace_header(header, value);
+    }
 
     if(applyConfigHeaders) {
         __applyConfigHeaders(con);
@@ -214,35 +736,72 @@ void handleHTTP(websocketpp::connection_hdl handler) {
 void handleConnect(websocketpp::connection_hdl handler) {
     websocketserver::connection_ptr con = server->get_con_from_hdl(handler);
     string url = con->get_resource();
-    if(__isExtensionEndpoint(url)) {
-        string extensionId = __getExtensionIdFromUrl(url);
-        extConnections[extensionId] = handler;
-        events::dispatch("extClientConnect", extensionId);
+    neuserver::ClientState clientState;
+    if(nativeWorkers) {
+        clientState.strand = make_shared<nativeStrand>(asio::make_strand(nativeWorkers->get_executor()));
+    }
+    clientState.format = __getMessageFormatFromUrl(url);
+    // permessage-deflate is the only extension the server negotiates
+    clientState.compressed = !con->get_response_header("Sec-WebSocket-Extensions").empty();
+    clientState.extension = __isExtensionEndpoint(url);
+    if(clientState.extension) {
+        clientState.extensionId = __getExtensionIdFromUrl(url);
+    }
+    neuserver::MessageFormat format = clientState.format;
+    clientState.queue = sendqueue::makeQueue([=](const json &message) {
+        return __prepareMessage(__serializeMessage(message, format), __getOpcode(format));
+    });
+
+    neuserver::RegistryPtr clients = __updateRegistry([&](neuserver::Registry &registry) {
+        registry.clientStates[handler] = clientState;
+        registry.unfilteredClients.insert(handler);
+        if(clientState.extension) {
+            registry.extConnections[clientState.extensionId] = handler;
+        }
+        else {
+            registry.appConnections.insert(handler);
+        }
+    });
+    if(clientState.extension) {
+        events::dispatch("extClientConnect", clientState.extensionId);
     }
     else {
-        appConnections.insert(handler);
-        events::dispatch("appClientConnect", appConnections.size());
+        events::dispatch("appClientConnect", clients->appConnections.size());
     }
-    events::dispatch("clientConnect", appConnections.size() + extConnections.size());
+    events::dispatch("clientConnect", clients->appConnections.size() + clients->extConnections.size());
 }
 
 void handleDisconnect(websocketpp::connection_hdl handler) {
     websocketserver::connection_ptr con = server->get_con_from_hdl(handler);
     string url = con->get_resource();
-    if(__isExtensionEndpoint(url)) {
-        string extensionId = __getExtensionIdFromUrl(url);
-        extConnections.erase(extensionId);
+    bool extension = __isExtensionEndpoint(url);
+    string extensionId = extension ? __getExtensionIdFromUrl(url) : "";
+
+    neuserver::RegistryPtr clients = __updateRegistry([&](neuserver::Registry &registry) {
+        auto it = registry.clientStates.find(handler);
+        if(it != registry.clientStates.end()) {
+            __removeSubscriptions(registry, handler, it->second);
+            sendqueue::close(it->second.queue);
+            registry.clientStates.erase(it);
+        }
+        if(extension) {
+            registry.extConnections.erase(extensionId);
+        }
+        else {
+            registry.appConnections.erase(handler);
+        }
+    });
+    if(extension) {
         events::dispatch("extClientDisconnect", extensionId);
     }
     else {
         settings::AppMode mode = settings::getMode();
-        appConnections.erase(handler);
         if(mode == settings::AppModeBrowser || mode == settings::AppModeChrome) {
             __exitProcessIfIdle();
         }
-        events::dispatch("appClientDisconnect", appConnections.size());
+        events::dispatch("appClientDisconnect", clients->appConnections.size());
     }
-    events::dispatch("clientDisconnect", appConnections.size() + extConnections.size());
+    events::dispatch("clientDisconnect", clients->appConnections.size() + clients->extConnections.size());
 }
 
 bool handleValidate(websocketpp::connection_hdl handler) {
@@ -271,34 +830,83 @@ bool handleValidate(websocketpp::connection_hdl handler) {
     return true;
 }
 
-void broadcast(const json &message) {
-    neuserver::broadcastToAllApps(message);
-    neuserver::broadcastToAllExtensions(message);
+void broadcast(json message) {
+    wsclientsList clients;
+    __addSubscribers(*__getRegistry(), clients, __getEventName(message), neuserver::BroadcastScopeAll);
+    __sendToClients(clients, move(message));
 }
 
-bool sendToExtension(const string &extensionId, const json &message) {
-    if(extConnections.find(extensionId) != extConnections.end()) {
-        server->send(extConnections[extensionId], helpers::jsonToString(message), websocketpp::frame::opcode::text);
+bool sendToExtension(const string &extensionId, json message) {
+    neuserver::RegistryPtr clients = __getRegistry();
+    auto connection = clients->extConnections.find(extensionId);
+    if(connection == clients->extConnections.end()) {
+        return false;
+    }
+    auto it = clients->clientStates.find(connection->second);
+    if(it == clients->clientStates.end() || !__isSubscribed(it->second, __getEventName(message))) {
         return true;
     }
-    return false;
+    return __sendToClients({{connection->second, it->second.format, it->second.compressed, it->second.queue}},
+            move(message));
 }
 
-void broadcastToAllExtensions(const json &message) {
-    for (const auto &[_, connection]: extConnections) {
-        server->send(connection, helpers::jsonToString(message), websocketpp::frame::opcode::text);
+// Sends the message to one connection if it's still open and subscribed to the event
+bool sendToConnection(websocketpp::connection_hdl handler, json message) {
+    neuserver::RegistryPtr clients = __getRegistry();
+    auto it = clients->clientStates.find(handler);
+    if(it == clients->clientStates.end()) {
+        return false;
     }
+    if(!__isSubscribed(it->second, __getEventName(message))) {
+        return true;
+    }
+    return __sendToClients({{it->first, it->second.format, it->second.compressed, it->second.queue}},
+            move(message));
+}
+
+void broadcastToAllExtensions(json message) {
+    wsclientsList clients;
+    __addSubscribers(*__getRegistry(), clients, __getEventName(message), neuserver::BroadcastScopeExtensions);
+    __sendToClients(clients, move(message));
+}
+
+void broadcastToAllApps(json message) {
+    wsclientsList clients;
+    __addSubscribers(*__getRegistry(), clients, __getEventName(message), neuserver::BroadcastScopeApps);
+    __sendToClients(clients, move(message));
 }
 
-void broadcastToAllApps(const json &message) {
-    for (const auto &connection: appConnections) {
-        server->send(connection, helpers::jsonToString(message), websocketpp::frame::opcode::text);
+json getConnectionStats() {
+    json stats = json::array();
+    neuserver::RegistryPtr clients = __getRegistry();
+    for(const auto &[connection, clientState]: clients->clientStates) {
+        websocketpp::lib::error_code ec;
+        websocketserver::connection_ptr con = server->get_con_from_hdl(connection, ec);
+        if(ec || !clientState.queue) {
+            continue;
+        }
+        sendqueue::Stats queueStats = sendqueue::getStats(clientState.queue);
+        json connectionStats;
+        connectionStats["type"] = clientState.extension ? "extension" : "app";
+        if(clientState.extension) {
+            connectionStats["extensionId"] = clientState.extensionId;
+        }
+        connectionStats["bufferedBytes"] = con->get_buffered_amount();
+        connectionStats["queuedBytes"] = queueStats.queuedBytes;
+        connectionStats["queuedMessages"] = queueStats.queuedMessages;
+        connectionStats["dropped"] = queueStats.dropped;
+        connectionStats["coalesced"] = queueStats.coalesced;
+        connectionStats["merged"] = queueStats.merged;
+        connectionStats["blocked"] = queueStats.blocked;
+        stats.push_back(connectionStats);
     }
+    return stats;
 }
 
 vector<string> getConnectedExtensions() {
     vector<string> extensions;
-    for (const auto &[extensionId, _]: extConnections) {
+    neuserver::RegistryPtr clients = __getRegistry();
+    for (const auto &[extensionId, _]: clients->extConnections) {
         extensions.push_back(extensionId);
     }
     return extensions;
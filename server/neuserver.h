@@ -4,10 +4,8 @@
 #include <string>
 #include <vector>
 
-#include <websocketpp/config/asio_no_tls.hpp>
-#include <websocketpp/server.hpp>
-
 #include "lib/json/json.hpp"
+#include "server/wsconfig.h"
 
 using namespace std;
 using json = nlohmann::json;
@@ -18,16 +16,18 @@ string init();
 bool isInitialized();
 void startAsync();
 void stop();
-void handleMessage(websocketpp::connection_hdl handler, websocketpp::server<websocketpp::config::asio>::message_ptr msg);
+void handleMessage(websocketpp::connection_hdl handler, websocketserver::message_ptr msg);
 void handleHTTP(websocketpp::connection_hdl handler);
 void handleConnect(websocketpp::connection_hdl handler);
 void handleDisconnect(websocketpp::connection_hdl handler);
 bool handleValidate(websocketpp::connection_hdl handler);
-void broadcast(const json &message);
-void broadcastToAllExtensions(const json &message);
-void broadcastToAllApps(const json &message);
-bool sendToExtension(const string &extensionId, const json &message);
+void broadcast(json message);
+void broadcastToAllExtensions(json message);
+void broadcastToAllApps(json message);
+bool sendToExtension(const string &extensionId, json message);
+bool sendToConnection(websocketpp::connection_hdl handler, json message);
 vector<string> getConnectedExtensions();
+json getConnectionStats();
 string getDocumentRoot();
 
 } // namespace neuserver
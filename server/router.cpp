@@ -1,9 +1,14 @@
 #include <iostream>
 #include <string>
 #include <fstream>
-#include <regex>
 #include <vector>
+#include <set>
+#include <mutex>
+#include <future>
 #include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 
 #include <websocketpp/server.hpp>
 
@@ -12,10 +17,14 @@
 #include "auth/permission.h"
 #include "server/router.h"
 #include "server/neuserver.h"
+#include "server/urlparser.h"
+#include "server/assetcache.h"
+#include "server/compression.h"
 #include "helpers.h"
 #include "errors.h"
 #include "settings.h"
 #include "resources.h"
+#include "scheduler.h"
 #include "api/os/os.h"
 #include "api/fs/fs.h"
 #include "api/computer/computer.h"
@@ -35,6 +44,13 @@
 #include <dispatch/dispatch.h>
 #endif
 
+#define NEU_MAX_RANGE_SIZE 8388608
+#define NEU_MIN_COMPRESSIBLE_SIZE 1024
+#define NEU_BATCH_METHOD "batch"
+#define NEU_ASSET_PROFILE_FILE "/.tmp/startup_assets.json"
+#define NEU_ASSET_PROFILE_RECORD_TIME 10000
+#define NEU_ASSET_PROFILE_MAX_SIZE 256
+
 using namespace std;
 
 using json = nlohmann::json;
@@ -50,6 +66,7 @@ map<string, router::NativeMethod> methodMap = {
     {"app.readProcessInput", app::controllers::readProcessInput},
     {"app.writeProcessOutput", app::controllers::writeProcessOutput},
     {"app.writeProcessError", app::controllers::writeProcessError},
+    {"app.cancelCall", app::controllers::cancelCall},
     // Neutralino.window
     {"window.setTitle", window::controllers::setTitle},
     {"window.getTitle", window::controllers::getTitle},
@@ -123,6 +140,9 @@ map<string, router::NativeMethod> methodMap = {
     {"os.spawnProcess", os::controllers::spawnProcess},
     {"os.updateSpawnedProcess", os::controllers::updateSpawnedProcess},
     {"os.getSpawnedProcesses", os::controllers::getSpawnedProcesses},
+    {"os.createProcessPool", os::controllers::createProcessPool},
+    {"os.callProcessPool", os::controllers::callProcessPool},
+    {"os.destroyProcessPool", os::controllers::destroyProcessPool},
     {"os.getEnv", os::controllers::getEnv},
     {"os.getEnvs", os::controllers::getEnvs},
     {"os.showOpenDialog", os::controllers::showOpenDialog},
@@ -165,79 +185,484 @@ map<string, router::NativeMethod> methodMap = {
     {"server.mount", server::controllers::mount},
     {"server.unmount", server::controllers::unmount},
     {"server.getMounts", server::controllers::getMounts},
+    {"server.getConnectionStats", server::controllers::getConnectionStats},
     // Neutralino.custom
     {"custom.getMethods", custom::controllers::getMethods},
     // {"custom.add", custom::controllers::add} // Sample custom method
 
 };
 
-map<string, router::NativeMethod> getMethodMap() {
+// Long-running methods that don't need to keep the order of the connection.
+// The server runs these outside the connection's queue and sends responses
+// whenever they complete, matched by the native message id. Methods that
+// change files stay in the queue, so i.e., a write and a move of the same
+// file don't swap.
+set<string> asyncMethods = {
+    "app.readProcessInput",
+    "app.cancelCall",
+    "filesystem.readFile",
+    "filesystem.readBinaryFile",
+    "filesystem.readDirectory",
+    "os.execCommand",
+    "os.callProcessPool",
+    "os.showOpenDialog",
+    "os.showFolderDialog",
+    "os.showSaveDialog",
+    "os.showMessageBox",
+    "resources.extractDirectory"
+};
+
+// Collects the responses of a batch. Calls of a batch can complete out of
+// order (i.e., deferred calls), so the batch responds after the last one.
+struct NativeBatch {
+    json responses = json::array();
+    size_t pendingCalls = 0;
+    mutex responsesLock;
+};
+
+// Message ids are chosen by clients, so calls are found by connection and id
+struct ActiveCallKey {
+    websocketpp::connection_hdl connection;
+    string id;
+
+    bool operator<(const ActiveCallKey &other) const {
+        if(connection.owner_before(other.connection)) return true;
+        if(other.connection.owner_before(connection)) return false;
+        return id < other.id;
+    }
+};
+
+map<router::ActiveCallKey, router::NativeCallPtr> activeCalls;
+mutex activeCallsLock;
+thread_local router::NativeCallPtr currentCall = nullptr;
+
+vector<router::NativeMethodEntry> methodTable;
+vector<uint32_t> methodDisplacements;
+uint64_t methodTableMask = 0;
+uint64_t methodBucketMask = 0;
+bool apiAccess = false;
+bool windowMode = false;
+bool assetCompression = false;
+
+// FNV-1a, used to find the bucket and the slot of a method in the dispatch table
+uint64_t __hashMethod(string_view method) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(const char c: method) {
+        hash ^= (unsigned char) c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t __getMethodSlot(uint64_t hash, uint32_t displacement) {
+    uint64_t slot = hash ^ ((uint64_t) displacement * 0x9e3779b97f4a7c15ULL);
+    slot ^= slot >> 31;
+    slot *= 0xbf58476d1ce4e5b9ULL;
+    slot ^= slot >> 29;
+    return slot & methodTableMask;
+}
+
+// Builds a collision-free (perfect) hash table over the method map with the
+// hash-and-displace technique: methods are grouped into small buckets and each
+// bucket gets a displacement value that places all of its methods in free slots.
+bool __buildMethodTable(size_t tableSize, size_t bucketCount) {
+    methodTableMask = tableSize - 1;
+    methodBucketMask = bucketCount - 1;
+    methodTable.assign(tableSize, router::NativeMethodEntry());
+    methodDisplacements.assign(bucketCount, 0);
+
+    vector<vector<router::NativeMethodEntry>> buckets(bucketCount);
+    for(const auto &[methodName, nativeMethod]: methodMap) {
+        router::NativeMethodEntry entry;
+        entry.name = methodName;
+        entry.hash = __hashMethod(methodName);
+        entry.method = nativeMethod;
+        entry.allowed = permission::hasMethodAccess(methodName);
+        entry.windowOnly = helpers::startsWith(methodName, "window.");
+        // In macos, child threads cannot run UI logic
+        entry.mainThread = methodName == "os.showMessageBox" ||
+                            methodName == "os.setTray" ||
+                            helpers::startsWith(methodName, "window.") ||
+                            helpers::startsWith(methodName, "computer.");
+        entry.async = asyncMethods.find(methodName) != asyncMethods.end();
+        buckets[entry.hash & methodBucketMask].push_back(entry);
+    }
+
+    vector<size_t> bucketOrder(bucketCount);
+    for(size_t i = 0; i < bucketCount; i++) {
+        bucketOrder[i] = i;
+    }
+    sort(bucketOrder.begin(), bucketOrder.end(), [&](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    vector<uint64_t> slots;
+    for(const size_t bucket: bucketOrder) {
+        if(buckets[bucket].empty()) {
+            break;
+        }
+        bool placed = false;
+        for(uint32_t displacement = 0; displacement < 0x10000 && !placed; displacement++) {
+            slots.clear();
+            placed = true;
+            for(const auto &entry: buckets[bucket]) {
+                uint64_t slot = __getMethodSlot(entry.hash, displacement);
+                if(methodTable[slot].method || find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if(placed) {
+                methodDisplacements[bucket] = displacement;
+                for(size_t i = 0; i < slots.size(); i++) {
+                    methodTable[slots[i]] = buckets[bucket][i];
+                }
+            }
+        }
+        if(!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void init() {
+    assetcache::init();
+    apiAccess = permission::hasAPIAccess();
+    windowMode = settings::getMode() == settings::AppModeWindow;
+    json jAssetCompression = settings::getOptionForCurrentMode("assetCompression");
+    assetCompression = jAssetCompression.is_boolean() ? jAssetCompression.get<bool>() :
+                        settings::getMode() == settings::AppModeCloud;
+
+    size_t tableSize = 1;
+    while(tableSize < methodMap.size() * 2) {
+        tableSize <<= 1;
+    }
+    size_t bucketCount = 1;
+    while(bucketCount * 4 < methodMap.size()) {
+        bucketCount <<= 1;
+    }
+    while(!__buildMethodTable(tableSize, bucketCount)) {
+        tableSize <<= 1;
+    }
+}
+
+const router::NativeMethodEntry *findNativeMethod(string_view method) {
+    if(methodTable.empty()) {
+        return nullptr;
+    }
+    uint64_t hash = __hashMethod(method);
+    const router::NativeMethodEntry &entry =
+        methodTable[__getMethodSlot(hash, methodDisplacements[hash & methodBucketMask])];
+    // Unknown methods can land on any slot, so confirm the match
+    if(!entry.method || entry.hash != hash || entry.name != method) {
+        return nullptr;
+    }
+    return &entry;
+}
+
+const map<string, router::NativeMethod> &getMethodMap() {
     return methodMap;
 }
 
-router::NativeMessage executeNativeMethod(const router::NativeMessage &request) {
-    string nativeMethodId = request.method;
+bool isAsyncMethod(const string &method) {
+    const router::NativeMethodEntry *entry = router::findNativeMethod(method);
+    return entry && entry->async;
+}
+
+bool __isBatch(const router::NativeMessage &request) {
+    return request.method == NEU_BATCH_METHOD;
+}
+
+// A batch is as slow as its slowest call
+bool isAsyncRequest(const router::NativeMessage &request) {
+    if(!__isBatch(request)) {
+        return router::isAsyncMethod(request.method);
+    }
+    if(!request.data.is_object() || !request.data.contains("calls") || !request.data["calls"].is_array()) {
+        return false;
+    }
+    for(const json &call: request.data["calls"]) {
+        if(call.is_object() && call.contains("method") && call["method"].is_string() &&
+            router::isAsyncMethod(call["method"].get<string>())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void __removeActiveCall(const router::NativeCallPtr &call) {
+    lock_guard<mutex> guard(activeCallsLock);
+    auto it = activeCalls.find({call->connection, call->id});
+    if(it != activeCalls.end() && it->second == call) {
+        activeCalls.erase(it);
+    }
+}
+
+router::NativeCallPtr deferCurrentCall() {
+    if(currentCall) {
+        currentCall->deferred = true;
+    }
+    return currentCall;
+}
+
+// Sends the response of a deferred call. Only the first completion is sent,
+// later ones (i.e., a worker response after a cancel) are ignored.
+bool completeCall(const router::NativeCallPtr &call, const json &output) {
+    if(!call || call->completed.exchange(true)) {
+        return false;
+    }
+    __removeActiveCall(call);
+    if(call->responseHandler) {
+        call->responseHandler({call->id, call->method, "", output, call->connection});
+    }
+    return true;
+}
+
+void setCancelHandler(const router::NativeCallPtr &call, const function<void()> &cancelHandler) {
+    if(!call) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(call->cancelHandlerLock);
+        if(!call->cancelled) {
+            call->cancelHandler = cancelHandler;
+            return;
+        }
+    }
+    // The call was cancelled before the controller set the handler
+    if(cancelHandler) {
+        cancelHandler();
+    }
+}
+
+// Cancels a call of the given connection
+bool cancelCall(const websocketpp::connection_hdl &connection, const string &id) {
+    router::NativeCallPtr call;
+    {
+        lock_guard<mutex> guard(activeCallsLock);
+        auto it = activeCalls.find({connection, id});
+        if(it == activeCalls.end()) {
+            return false;
+        }
+        call = it->second;
+    }
+    // The handler is taken under the lock, so it runs only once even if
+    // setCancelHandler or another cancelCall races with this one
+    function<void()> cancelHandler;
+    {
+        lock_guard<mutex> guard(call->cancelHandlerLock);
+        call->cancelled = true;
+        cancelHandler = move(call->cancelHandler);
+        call->cancelHandler = nullptr;
+    }
+    if(cancelHandler) {
+        cancelHandler();
+    }
+    json output;
+    output["error"] = errors::makeErrorPayload(errors::NE_RT_NATCNCL, call->method);
+    return completeCall(call, output);
+}
+
+bool isCurrentCallCancelled() {
+    return currentCall && currentCall->cancelled;
+}
+
+websocketpp::connection_hdl getCurrentConnection() {
+    return currentCall ? currentCall->connection : websocketpp::connection_hdl();
+}
+
+// Runs a native method whose access token was already verified
+router::NativeMessage __runNativeMethod(const router::NativeMessage &request) {
+    const string &nativeMethodId = request.method;
     router::NativeMessage response;
     response.id = request.id;
     response.method = request.method;
 
-    if(!authbasic::verifyToken(request.accessToken)) {
-        response.data["error"] = errors::makeErrorPayload(errors::NE_RT_INVTOKN);
-        return response;
-    }
-    if(!permission::hasAPIAccess()) {
+    if(!apiAccess) {
         response.data["error"] = errors::makeErrorPayload(errors::NE_RT_APIPRME);
         return response;
     }
-    if(!permission::hasMethodAccess(nativeMethodId)) {
+
+    const router::NativeMethodEntry *entry = router::findNativeMethod(nativeMethodId);
+    // Unknown methods are not in the table, but the permission error still has priority
+    if(entry ? !entry->allowed : !permission::hasMethodAccess(nativeMethodId)) {
         response.data["error"] = errors::makeErrorPayload(errors::NE_RT_NATPRME, nativeMethodId);
         return response;
     }
+    if(!entry) {
+        response.data["error"] = errors::makeErrorPayload(errors::NE_RT_NATNTIM, nativeMethodId);
+        return response;
+    }
 
-    if(methodMap.find(nativeMethodId) != methodMap.end()) {
-        try {
-            if(settings::getMode() != settings::AppModeWindow
-                && regex_match(nativeMethodId, regex("^window.*"))) {
-                response.data["success"] = true;
-                response.data["message"] = "Discarded. "+ nativeMethodId + " works within the window mode only";
-                return response;
-            }
-            router::NativeMethod nativeMethod = methodMap[nativeMethodId];
-            #if defined(__linux__) || defined(_WIN32) || defined(__FreeBSD__)
-            json apiOutput;
-            #endif
-            #if defined(__APPLE__)
-            __block json apiOutput;
-            // In macos, child threads cannot run UI logic
-            if(nativeMethodId == "os.showMessageBox" ||
-                regex_match(nativeMethodId, regex("^window.*")) ||
-                regex_match(nativeMethodId, regex("^computer.*")) ||
-                nativeMethodId == "os.setTray") {
-                dispatch_sync(dispatch_get_main_queue(), ^{
-                    apiOutput = (*nativeMethod)(request.data);
-                });
-            }
-            else {
-                apiOutput = (*nativeMethod)(request.data);
-            }
-            #else
-                apiOutput = (*nativeMethod)(request.data);
-            #endif
-            response.data = apiOutput;
+    try {
+        if(!windowMode && entry->windowOnly) {
+            response.data["success"] = true;
+            response.data["message"] = "Discarded. "+ nativeMethodId + " works within the window mode only";
             return response;
         }
-        catch(const exception& e){
-            response.data["error"] = errors::makeErrorPayload(errors::NE_RT_NATRTER);
-            return response;
+        router::NativeMethod nativeMethod = entry->method;
+        #if defined(__linux__) || defined(_WIN32) || defined(__FreeBSD__)
+        json apiOutput;
+        #endif
+        #if defined(__APPLE__)
+        __block json apiOutput;
+        if(entry->mainThread) {
+            dispatch_sync(dispatch_get_main_queue(), ^{
+                apiOutput = (*nativeMethod)(request.data);
+            });
         }
+        else {
+            apiOutput = (*nativeMethod)(request.data);
+        }
+        #else
+            apiOutput = (*nativeMethod)(request.data);
+        #endif
+        response.data = apiOutput;
+        return response;
     }
-    else {
-        response.data["error"] = errors::makeErrorPayload(errors::NE_RT_NATNTIM, nativeMethodId);
+    catch(const exception& e){
+        response.data["error"] = errors::makeErrorPayload(errors::NE_RT_NATRTER);
         return response;
     }
 }
 
-map<string, string> mountedPaths = {};
+void __executeCall(const router::NativeMessage &request, const router::NativeResponseHandler &responseHandler,
+        bool tokenVerified = false) {
+    router::NativeCallPtr call = make_shared<router::NativeCall>();
+    call->id = request.id;
+    call->method = request.method;
+    call->connection = request.connection;
+    call->responseHandler = responseHandler;
+
+    if(!call->id.empty()) {
+        lock_guard<mutex> guard(activeCallsLock);
+        activeCalls[{call->connection, call->id}] = call;
+    }
+
+    router::NativeCallPtr parentCall = currentCall;
+    currentCall = call;
+    router::NativeMessage response = tokenVerified ? __runNativeMethod(request) : router::executeNativeMethod(request);
+    currentCall = parentCall;
+
+    // A deferred call that fails (i.e., throws) before it's handed over never
+    // gets completed by the controller, so the error is sent from here
+    bool failed = response.data.is_object() && response.data.contains("error");
+    if(!call->deferred || failed) {
+        completeCall(call, response.data);
+    }
+}
+
+void __releaseBatchCall(const shared_ptr<NativeBatch> &batch, const router::NativeMessage &batchResponse,
+    const router::NativeResponseHandler &responseHandler) {
+    router::NativeMessage completedResponse = batchResponse;
+    {
+        lock_guard<mutex> guard(batch->responsesLock);
+        if(--batch->pendingCalls > 0) {
+            return;
+        }
+        completedResponse.data["success"] = true;
+        completedResponse.data["returnValue"] = move(batch->responses);
+    }
+    responseHandler(completedResponse);
+}
+
+void __completeBatchCall(const shared_ptr<NativeBatch> &batch, size_t index,
+    const router::NativeMessage &response, const router::NativeMessage &batchResponse,
+    const router::NativeResponseHandler &responseHandler) {
+    {
+        lock_guard<mutex> guard(batch->responsesLock);
+        batch->responses[index] = {
+            {"id", response.id},
+            {"method", response.method},
+            {"data", response.data}
+        };
+    }
+    __releaseBatchCall(batch, batchResponse, responseHandler);
+}
+
+// Runs the calls of a batch in order and responds with an array of their
+// responses. Each call goes through the usual permission checks, and errors
+// stay within the call's own response.
+void __executeBatch(const router::NativeMessage &request, const router::NativeResponseHandler &responseHandler) {
+    router::NativeMessage batchResponse = {request.id, request.method, "", json(), request.connection};
+    if(!authbasic::verifyToken(request.accessToken)) {
+        batchResponse.data["error"] = errors::makeErrorPayload(errors::NE_RT_INVTOKN);
+        responseHandler(batchResponse);
+        return;
+    }
+    if(!request.data.is_object() || !helpers::hasField(request.data, "calls") || !request.data["calls"].is_array()) {
+        batchResponse.data["error"] = errors::makeMissingArgErrorPayload("calls");
+        responseHandler(batchResponse);
+        return;
+    }
+
+    const json &calls = request.data["calls"];
+    shared_ptr<NativeBatch> batch = make_shared<NativeBatch>();
+    batch->responses = json::array();
+    for(size_t i = 0; i < calls.size(); i++) {
+        batch->responses.push_back(nullptr);
+    }
+    // The extra pending call keeps the batch open until all calls are started
+    batch->pendingCalls = calls.size() + 1;
+
+    for(size_t i = 0; i < calls.size(); i++) {
+        const json &call = calls[i];
+        router::NativeMessage callRequest;
+        callRequest.connection = request.connection;
+        if(call.is_object() && call.contains("id") && call["id"].is_string()) {
+            callRequest.id = call["id"].get<string>();
+        }
+        if(!call.is_object() || !call.contains("method") || !call["method"].is_string()) {
+            router::NativeMessage callResponse = {callRequest.id, "", "", json(), callRequest.connection};
+            callResponse.data["error"] = errors::makeMissingArgErrorPayload("method");
+            __completeBatchCall(batch, i, callResponse, batchResponse, responseHandler);
+            continue;
+        }
+        callRequest.method = call["method"].get<string>();
+        if(call.contains("data")) {
+            callRequest.data = call["data"];
+        }
+        // Batches can't be nested, so the batch method is not found here.
+        // The token was verified for the whole batch above.
+        __executeCall(callRequest, [=](const router::NativeMessage &callResponse) {
+            __completeBatchCall(batch, i, callResponse, batchResponse, responseHandler);
+        }, true);
+    }
+    __releaseBatchCall(batch, batchResponse, responseHandler);
+}
+
+void executeNativeMethod(const router::NativeMessage &request, const router::NativeResponseHandler &responseHandler) {
+    if(__isBatch(request)) {
+        __executeBatch(request, responseHandler);
+        return;
+    }
+    __executeCall(request, responseHandler);
+}
+
+router::NativeMessage executeNativeMethod(const router::NativeMessage &request) {
+    if(!authbasic::verifyToken(request.accessToken)) {
+        router::NativeMessage response;
+        response.id = request.id;
+        response.method = request.method;
+        response.data["error"] = errors::makeErrorPayload(errors::NE_RT_INVTOKN);
+        return response;
+    }
+    return __runNativeMethod(request);
+}
+
+typedef shared_ptr<const map<string, string>> MountsPtr;
+
+// Mounts change on native worker threads while the I/O threads serve assets,
+// so updates publish a new copy and readers use the snapshot they loaded
+MountsPtr mountedPaths = make_shared<const map<string, string>>();
+// Only serializes mount updates, readers never take it
+mutex mountsLock;
+
+MountsPtr __getMounts() {
+    return atomic_load(&mountedPaths);
+}
 
 errors::StatusCode mountPath(string &path, string &target) {
     path = helpers::normalizePath(path);
@@ -255,16 +680,20 @@ errors::StatusCode mountPath(string &path, string &target) {
     if(!filesystem::is_directory(targetPath)) {
         return errors::NE_FS_NOTADIR;
     }
+
+    lock_guard<mutex> guard(mountsLock);
     if(router::isMounted(path)) {
         return errors::NE_SR_MPINUSE;
     }
-
-    mountedPaths[path] = target;
+    auto nextMounts = make_shared<map<string, string>>(*__getMounts());
+    (*nextMounts)[path] = target;
+    atomic_store(&mountedPaths, MountsPtr(nextMounts));
     return errors::NE_ST_OK;
 }
 
 bool isMounted(const string &path) {
-    return mountedPaths.find(path) != mountedPaths.end();
+    MountsPtr mounts = __getMounts();
+    return mounts->find(path) != mounts->end();
 }
 
 bool unmountPath(string &path) {
@@ -273,108 +702,486 @@ bool unmountPath(string &path) {
     if(path.empty()) {
         path = "/";
     }
+
+    lock_guard<mutex> guard(mountsLock);
     if(!router::isMounted(path)) {
         return false;
     }
-    
-    mountedPaths.erase(path);
+    auto nextMounts = make_shared<map<string, string>>(*__getMounts());
+    nextMounts->erase(path);
+    atomic_store(&mountedPaths, MountsPtr(nextMounts));
     return true;
 }
 
 map<string, string> getMounts() {
-    return mountedPaths;
+    return *__getMounts();
+}
+
+const map<string, string> mimeTypes = {
+    // Plain text files
+    {"css", "text/css"},
+    {"csv", "text/csv"},
+    {"txt", "text/plain"},
+    {"vtt", "text/vtt"},
+    {"htm", "text/html"},
+    {"html", "text/html"},
+    // Image files
+    {"apng", "image/apng"},
+    {"avif", "image/avif"},
+    {"bmp", "image/bmp"},
+    {"gif", "image/gif"},
+    {"png", "image/png"},
+    {"svg", "image/svg+xml"},
+    {"webp", "image/webp"},
+    {"ico", "image/x-icon"},
+    {"tif", "image/tiff"},
+    {"tiff", "image/tiff"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    // Video files
+    {"mp4", "video/mp4"},
+    {"mpeg", "video/mpeg"},
+    {"webm", "video/webm"},
+    // Audio files
+    {"mp3", "audio/mp3"},
+    {"mpga", "audio/mpeg"},
+    {"weba", "audio/webm"},
+    {"wav", "audio/wave"},
+    // Font files
+    {"otf", "font/otf"},
+    {"ttf", "font/ttf"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    // Application-type files
+    {"7z", "application/x-7z-compressed"},
+    {"atom", "application/atom+xml"},
+    {"pdf", "application/pdf"},
+    {"js", "application/javascript"},
+    {"mjs", "application/javascript"},
+    {"json", "application/json"},
+    {"rss", "application/rss+xml"},
+    {"tar", "application/x-tar"},
+    {"xht", "application/xhtml+xml"},
+    {"xhtml", "application/xhtml+xml"},
+    {"xslt", "application/xslt+xml"},
+    {"xml", "application/xml"},
+    {"gz", "application/gzip"},
+    {"zip", "application/zip"},
+    {"wasm", "application/wasm"}
+};
+
+struct AssetSource {
+    string path;
+    string diskPath;
+    string cacheKey;
+    long long size = -1;
+    long long modifiedAt = 0;
+};
+
+struct ByteRange {
+    bool requested = false;
+    bool satisfiable = true;
+    long long start = 0;
+    long long end = 0;
+};
+
+// Finds the asset on the disk (mounted paths and directory mode) or in the
+// resource bundle without reading it
+bool __findAssetSource(router::AssetSource &source) {
+    if(!source.diskPath.empty()) {
+        source.cacheKey = "fs:" + source.diskPath;
+        fs::FileStats fileStats = fs::getStats(source.diskPath);
+        if(fileStats.status != errors::NE_ST_OK || fileStats.entryType != fs::EntryTypeFile) {
+            assetcache::remove(source.cacheKey);
+            return false;
+        }
+        source.size = fileStats.size;
+        source.modifiedAt = fileStats.modifiedAt;
+        return true;
+    }
+    source.cacheKey = "res:" + source.path;
+    source.size = resources::getFileSize(source.path);
+    return source.size >= 0;
+}
+
+// Disk-backed entries are validated with the file stats on each hit, so
+// modified files are never served from the cache
+assetcache::AssetPtr __getCachedAsset(const router::AssetSource &source) {
+    assetcache::AssetPtr asset = assetcache::get(source.cacheKey);
+    if(asset && !source.diskPath.empty() &&
+        (asset->modifiedAt != source.modifiedAt || asset->size != source.size)) {
+        return nullptr;
+    }
+    return asset;
+}
+
+// Bundled assets are viewed in the mapped resource bundle instead of being read.
+// Compressed bundle assets are cached decompressed.
+assetcache::AssetPtr __readAsset(const router::AssetSource &source) {
+    assetcache::AssetPtr asset = __getCachedAsset(source);
+    if(asset) {
+        return asset;
+    }
+    if(!source.diskPath.empty()) {
+        fs::FileReaderResult fileReaderResult = fs::readFile(source.diskPath);
+        if(fileReaderResult.status == errors::NE_ST_OK) {
+            asset = assetcache::makeAsset(move(fileReaderResult.data), source.modifiedAt);
+        }
+    }
+    else {
+        resources::FileView fileView = resources::getFileView(source.path);
+        if(fileView.status == errors::NE_ST_OK && fileView.buffer) {
+            asset = assetcache::makeAsset(move(*fileView.buffer), source.modifiedAt);
+        }
+        else if(fileView.status == errors::NE_ST_OK) {
+            asset = assetcache::makeAssetView(fileView.data, source.modifiedAt);
+        }
+    }
+    if(!asset) {
+        assetcache::remove(source.cacheKey);
+        return nullptr;
+    }
+    assetcache::put(source.cacheKey, asset);
+    return asset;
+}
+
+// Parses single byte ranges (bytes=start-end, bytes=start-, and bytes=-suffix).
+// Multiple ranges are not supported, so those requests get the whole asset.
+router::ByteRange __parseRange(const string &range, long long size) {
+    router::ByteRange byteRange;
+    if(!helpers::startsWith(range, "bytes=") || range.find(',') != string::npos) {
+        return byteRange;
+    }
+    string_view spec = string_view(range).substr(6);
+    size_t separatorPos = spec.find('-');
+    if(separatorPos == string_view::npos) {
+        return byteRange;
+    }
+    string_view first = spec.substr(0, separatorPos);
+    string_view last = spec.substr(separatorPos + 1);
+    auto parseNumber = [](string_view value, long long &number) {
+        if(value.empty() || value.size() > 18) return false;
+        number = 0;
+        for(const char c: value) {
+            if(c < '0' || c > '9') return false;
+            number = number * 10 + (c - '0');
+        }
+        return true;
+    };
+
+    long long start = 0, end = size - 1;
+    if(first.empty()) {
+        long long suffixLength;
+        if(!parseNumber(last, suffixLength)) {
+            return byteRange;
+        }
+        byteRange.requested = true;
+        byteRange.satisfiable = suffixLength > 0 && size > 0;
+        start = max(0LL, size - suffixLength);
+    }
+    else {
+        if(!parseNumber(first, start)) {
+            return byteRange;
+        }
+        if(!last.empty()) {
+            if(!parseNumber(last, end) || end < start) {
+                return byteRange;
+            }
+            end = min(end, size - 1);
+        }
+        byteRange.requested = true;
+        byteRange.satisfiable = start < size;
+    }
+    // Browsers probe media with open-ended ranges, so all ranges are answered
+    // with a limited chunk and the client requests the rest as it plays
+    byteRange.start = start;
+    byteRange.end = min(end, start + NEU_MAX_RANGE_SIZE - 1);
+    return byteRange;
 }
 
-router::Response getAsset(string path, const string &prependData) {
+router::Response __getAssetRange(const router::AssetSource &source, const router::ByteRange &byteRange) {
+    router::Response response;
+    response.headers["Accept-Ranges"] = "bytes";
+    if(!byteRange.satisfiable) {
+        response.status = websocketpp::http::status_code::request_range_not_satisfiable;
+        response.headers["Content-Range"] = "bytes */" + to_string(source.size);
+        return response;
+    }
+
+    long long length = byteRange.end - byteRange.start + 1;
+    assetcache::AssetPtr asset = __getCachedAsset(source);
+    // Compressed bundle assets are decompressed as a whole, so the following ranges come from the cache
+    const resources::ResourceEntry *entry = !asset && source.diskPath.empty() ? resources::getEntry(source.path) : nullptr;
+    if(entry && entry->compressedSize > 0) {
+        asset = __readAsset(source);
+    }
+    fs::FileReaderOptions fileReaderOptions;
+    fileReaderOptions.pos = byteRange.start;
+    fileReaderOptions.size = length;
+    size_t dataSize = 0;
+    if(asset) {
+        response.dataView = asset->data.substr(byteRange.start, length);
+        response.dataOwner = asset;
+        dataSize = response.dataView.size();
+        response.headers["ETag"] = asset->etag;
+        response.headers["Last-Modified"] = asset->lastModified;
+    }
+    else if(!source.diskPath.empty()) {
+        fs::FileReaderResult fileReaderResult = fs::readFile(source.diskPath, fileReaderOptions);
+        if(fileReaderResult.status != errors::NE_ST_OK) {
+            response.status = websocketpp::http::status_code::not_found;
+            return response;
+        }
+        response.data = move(fileReaderResult.data);
+        dataSize = response.data.size();
+        // Lets If-Range requests validate without reading the whole file
+        response.headers["Last-Modified"] = assetcache::makeLastModified(source.modifiedAt);
+    }
+    else {
+        resources::FileView fileView = resources::getFileView(source.path, fileReaderOptions);
+        if(fileView.status != errors::NE_ST_OK) {
+            response.status = websocketpp::http::status_code::not_found;
+            return response;
+        }
+        response.dataView = fileView.data;
+        dataSize = response.dataView.size();
+    }
+    response.status = websocketpp::http::status_code::partial_content;
+    response.headers["Content-Range"] = "bytes " + to_string(byteRange.start) + "-" +
+        to_string(byteRange.start + dataSize - 1) + "/" + to_string(source.size);
+    return response;
+}
+
+string_view __trimView(string_view value) {
+    while(!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while(!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+// Checks whether the Accept-Encoding header lists the encoding without q=0
+bool __acceptsEncoding(string_view acceptEncoding, string_view encoding) {
+    while(!acceptEncoding.empty()) {
+        size_t separatorPos = acceptEncoding.find(',');
+        string_view token = acceptEncoding.substr(0, separatorPos);
+        acceptEncoding = separatorPos == string_view::npos ? "" : acceptEncoding.substr(separatorPos + 1);
+
+        size_t paramsPos = token.find(';');
+        if(__trimView(token.substr(0, paramsPos)) != encoding) {
+            continue;
+        }
+        if(paramsPos == string_view::npos) {
+            return true;
+        }
+        string_view quality = __trimView(token.substr(paramsPos + 1));
+        return !helpers::startsWith(quality, "q=0") || quality.find_first_of("123456789", 3) != string_view::npos;
+    }
+    return false;
+}
+
+bool __isCompressibleType(const string &contentType) {
+    return helpers::startsWith(contentType, "text/") ||
+            helpers::endsWith(contentType, "+xml") ||
+            helpers::endsWith(contentType, "/xml") ||
+            helpers::endsWith(contentType, "/javascript") ||
+            helpers::endsWith(contentType, "/json") ||
+            contentType == "application/wasm" ||
+            contentType == "font/otf" ||
+            contentType == "font/ttf";
+}
+
+// Returns the brotli/gzip variant of an asset. Precompressed siblings (i.e.,
+// app.js.br and app.js.gz) are preferred, otherwise compressible assets are
+// gzipped once and the result is cached with the original asset's ETag.
+assetcache::AssetPtr __getEncodedAsset(const router::AssetSource &source, const assetcache::AssetPtr &asset,
+    const string &contentType, const string &acceptEncoding, string &encoding) {
+    if(acceptEncoding.empty() || asset->size < NEU_MIN_COMPRESSIBLE_SIZE) {
+        return nullptr;
+    }
+    for(const auto &[extension, contentEncoding]: vector<pair<string, string>> {{"br", "br"}, {"gz", "gzip"}}) {
+        if(!__acceptsEncoding(acceptEncoding, contentEncoding)) {
+            continue;
+        }
+        router::AssetSource sibling;
+        sibling.path = source.path + "." + extension;
+        if(!source.diskPath.empty()) {
+            sibling.diskPath = source.diskPath + "." + extension;
+        }
+        assetcache::AssetPtr encodedAsset;
+        if(__findAssetSource(sibling) && (encodedAsset = __readAsset(sibling))) {
+            encoding = contentEncoding;
+            return encodedAsset;
+        }
+    }
+
+    if(!assetCompression || !compression::isGzipAvailable() || !__isCompressibleType(contentType) ||
+        !__acceptsEncoding(acceptEncoding, "gzip")) {
+        return nullptr;
+    }
+    string cacheKey = source.cacheKey + "|gzip|" + asset->etag;
+    assetcache::AssetPtr encodedAsset = assetcache::get(cacheKey);
+    if(!encodedAsset) {
+        string compressedData;
+        if(!compression::gzip(asset->data, compressedData) || compressedData.size() >= asset->data.size()) {
+            return nullptr;
+        }
+        encodedAsset = assetcache::makeAsset(move(compressedData), asset->modifiedAt);
+        assetcache::put(cacheKey, encodedAsset);
+    }
+    encoding = "gzip";
+    return encodedAsset;
+}
+
+// The assets requested during startup, so the next startup can prefetch them
+atomic<bool> recordingAssetProfile(false);
+vector<string> assetProfile;
+mutex assetProfileLock;
+
+void __recordAsset(const string &path) {
+    lock_guard<mutex> guard(assetProfileLock);
+    if(assetProfile.size() < NEU_ASSET_PROFILE_MAX_SIZE &&
+        find(assetProfile.begin(), assetProfile.end(), path) == assetProfile.end()) {
+        assetProfile.push_back(path);
+    }
+}
+
+void __saveAssetProfile() {
+    recordingAssetProfile = false;
+    json jAssetProfile;
+    {
+        lock_guard<mutex> guard(assetProfileLock);
+        if(assetProfile.empty()) {
+            return;
+        }
+        jAssetProfile = assetProfile;
+    }
+    error_code ec;
+    filesystem::create_directories(CONVSTR(settings::joinAppDataPath("/.tmp")), ec);
+    fs::FileWriterOptions writerOptions = { settings::joinAppDataPath(NEU_ASSET_PROFILE_FILE), jAssetProfile.dump() };
+    fs::writeFile(writerOptions);
+}
+
+vector<string> __loadAssetProfile() {
+    vector<string> paths;
+    fs::FileReaderResult readerResult = fs::readFile(settings::joinAppDataPath(NEU_ASSET_PROFILE_FILE));
+    if(readerResult.status != errors::NE_ST_OK) {
+        return paths;
+    }
+    json jAssetProfile = json::parse(readerResult.data, nullptr, false);
+    if(!jAssetProfile.is_array()) {
+        return paths;
+    }
+    for(const json &jPath: jAssetProfile) {
+        if(jPath.is_string()) {
+            paths.push_back(jPath.get<string>());
+        }
+    }
+    return paths;
+}
+
+// Reads the startup assets into the asset cache on a background thread, so
+// the first requests of the window don't wait for cold reads. The assets come
+// from the prefetchAssets option, or from the assets requested during the
+// previous startup if it's true.
+void prefetchAssets() {
+    json jPrefetchAssets = settings::getOptionForCurrentMode("prefetchAssets");
+    vector<string> paths;
+    if(jPrefetchAssets.is_array()) {
+        for(const json &jPath: jPrefetchAssets) {
+            if(jPath.is_string()) {
+                paths.push_back(jPath.get<string>());
+            }
+        }
+    }
+    else if(jPrefetchAssets.is_boolean() && jPrefetchAssets.get<bool>()) {
+        paths = __loadAssetProfile();
+        recordingAssetProfile = true;
+        scheduler::setTimeout(__saveAssetProfile, chrono::milliseconds(NEU_ASSET_PROFILE_RECORD_TIME));
+    }
+    if(paths.empty()) {
+        return;
+    }
+
+    thread prefetchThread([paths]() {
+        // Disk reads of all files start before the first one is cached
+        resources::prefetchFiles(paths);
+        for(const string &path: paths) {
+            router::AssetSource source;
+            source.path = path;
+            if(resources::isDirMode()) {
+                source.diskPath = settings::joinAppPath(path);
+            }
+            if(__findAssetSource(source)) {
+                __readAsset(source);
+            }
+        }
+    });
+    prefetchThread.detach();
+}
+
+router::Response getAsset(string path, const string &prependData, const string &range,
+    const string &acceptEncoding) {
     router::Response response;
     vector<string> split = helpers::split(path, '.');
 
     if(split.size() < 2) {
         if(path.back() != '/')
             path += "/";
-        return getAsset(path + "index.html", prependData);
+        return getAsset(path + "index.html", prependData, range, acceptEncoding);
     }
 
     string extension = split[split.size() - 1];
-    map<string, string> mimeTypes = {
-        // Plain text files
-        {"css", "text/css"},
-        {"csv", "text/csv"},
-        {"txt", "text/plain"},
-        {"vtt", "text/vtt"},
-        {"htm", "text/html"},
-        {"html", "text/html"},
-        // Image files
-        {"apng", "image/apng"},
-        {"avif", "image/avif"},
-        {"bmp", "image/bmp"},
-        {"gif", "image/gif"},
-        {"png", "image/png"},
-        {"svg", "image/svg+xml"},
-        {"webp", "image/webp"},
-        {"ico", "image/x-icon"},
-        {"tif", "image/tiff"},
-        {"tiff", "image/tiff"},
-        {"jpg", "image/jpeg"},
-        {"jpeg", "image/jpeg"},
-        // Video files
-        {"mp4", "video/mp4"},
-        {"mpeg", "video/mpeg"},
-        {"webm", "video/webm"},
-        // Audio files
-        {"mp3", "audio/mp3"},
-        {"mpga", "audio/mpeg"},
-        {"weba", "audio/webm"},
-        {"wav", "audio/wave"},
-        // Font files
-        {"otf", "font/otf"},
-        {"ttf", "font/ttf"},
-        {"woff", "font/woff"},
-        {"woff2", "font/woff2"},
-        // Application-type files
-        {"7z", "application/x-7z-compressed"},
-        {"atom", "application/atom+xml"},
-        {"pdf", "application/pdf"},
-        {"js", "application/javascript"},
-        {"mjs", "application/javascript"},
-        {"json", "application/json"},
-        {"rss", "application/rss+xml"},
-        {"tar", "application/x-tar"},
-        {"xht", "application/xhtml+xml"},
-        {"xhtml", "application/xhtml+xml"},
-        {"xslt", "application/xslt+xml"},
-        {"xml", "application/xml"},
-        {"gz", "application/gzip"},
-        {"zip", "application/zip"},
-        {"wasm", "application/wasm"}
-    };
-
-    fs::FileReaderResult fileReaderResult;
-    bool foundMountedPath = false;
+    router::AssetSource source;
+    source.path = path;
+    bool mounted = false;
 
-    if(mountedPaths.size() > 0) {
+    MountsPtr mounts = __getMounts();
+    if(mounts->size() > 0) {
         string pathname = path;
         string documentRoot = neuserver::getDocumentRoot();
         if(!documentRoot.empty()) {
             pathname = path.substr(documentRoot.length());
         }
-        for(const auto& [mountedPath, mountTarget] : mountedPaths) {
+        for(const auto& [mountedPath, mountTarget] : *mounts) {
             if(pathname.find(mountedPath) == 0) {
-                string adjustedPath = mountTarget + "/" + pathname.substr(mountedPath.length());
-                fileReaderResult = fs::readFile(adjustedPath);
-                foundMountedPath = true;
+                source.diskPath = mountTarget + "/" + pathname.substr(mountedPath.length());
+                mounted = true;
                 break;
             }
         }
     }
 
-    if(!foundMountedPath) {
-        fileReaderResult = resources::getFile(path);
+    if(source.diskPath.empty() && resources::isDirMode()) {
+        source.diskPath = settings::joinAppPath(path);
     }
-    
-    if(fileReaderResult.status != errors::NE_ST_OK) {
+
+    assetcache::AssetPtr asset;
+    bool found = __findAssetSource(source);
+    if(found && !range.empty() && prependData.empty()) {
+        router::ByteRange byteRange = __parseRange(range, source.size);
+        if(byteRange.requested) {
+            response = __getAssetRange(source, byteRange);
+            found = response.status != websocketpp::http::status_code::not_found;
+        }
+    }
+    bool streamed = found && response.status == websocketpp::http::status_code::ok &&
+        !source.diskPath.empty() && prependData.empty() && !assetcache::isCacheable(source.size);
+    if(streamed) {
+        response.bodyFilename = source.diskPath;
+        response.bodySize = source.size;
+        response.headers["Last-Modified"] = assetcache::makeLastModified(source.modifiedAt);
+        response.headers["Accept-Ranges"] = "bytes";
+    }
+    else if(found && response.status == websocketpp::http::status_code::ok) {
+        asset = __readAsset(source);
+        found = asset != nullptr;
+    }
+    if(found && !mounted && recordingAssetProfile) {
+        __recordAsset(path);
+    }
+
+    if(!found) {
         json jSpaServing = settings::getOptionForCurrentMode("singlePageServe");
-        if(!jSpaServing.is_null() && jSpaServing.get<bool>() && regex_match(path, regex(".*index.html$"))) {
+        if(!jSpaServing.is_null() && jSpaServing.get<bool>() && helpers::endsWith(path, "index.html")) {
             json jDocumentRoot = settings::getOptionForCurrentMode("documentRoot");
             string newPath;
             if(!jDocumentRoot.is_null()) {
@@ -383,53 +1190,108 @@ router::Response getAsset(string path, const string &prependData) {
             else {
                 newPath = settings::getNavigationUrl();
             }
-            if(newPath != path) return getAsset(newPath, prependData);
+            if(newPath != path) return getAsset(newPath, prependData, range, acceptEncoding);
         }
-    }
-    response.data = fileReaderResult.data;
-    response.status = websocketpp::http::status_code::ok;
-
-    if(fileReaderResult.status != errors::NE_ST_OK) {
         response.status = websocketpp::http::status_code::not_found;
+        response.data.clear();
+        response.dataView = string_view();
+        response.dataOwner = nullptr;
+        response.bodyFilename.clear();
+        response.headers.clear();
         debug::log(debug::LogTypeError, errors::makeErrorMsg(errors::NE_RS_UNBLDRE, path));
     }
-    else if(prependData != "") {
-        response.data = prependData + response.data;
+    else if(asset && prependData != "") {
+        response.data.reserve(prependData.size() + asset->data.size());
+        response.data.append(prependData).append(asset->data);
     }
 
     // If MIME-type is not defined in neuserver, application/octet-stream will be used by default.
-    if(mimeTypes.find(extension) != mimeTypes.end()) {
-        response.contentType = mimeTypes[extension];
+    auto mimeType = mimeTypes.find(extension);
+    if(mimeType != mimeTypes.end()) {
+        response.contentType = mimeType->second;
+    }
+
+    if(found && asset && prependData == "") {
+        string encoding;
+        assetcache::AssetPtr encodedAsset = __getEncodedAsset(source, asset, response.contentType,
+                                                acceptEncoding, encoding);
+        if(encodedAsset) {
+            asset = encodedAsset;
+            response.headers["Content-Encoding"] = encoding;
+        }
+        response.dataView = asset->data;
+        response.dataOwner = asset;
+        // Prepended data (i.e., globals with the one-time token) differ per
+        // request, so only plain assets get validators
+        response.headers["ETag"] = asset->etag;
+        response.headers["Last-Modified"] = asset->lastModified;
+        response.headers["Accept-Ranges"] = "bytes";
+        response.headers["Vary"] = "Accept-Encoding";
     }
     return response;
 }
 
-router::Response serve(string path) {
-    char *originalPath = (char *) path.c_str();
-    char *decodedPath = new char[strlen(originalPath) + 1];
-    helpers::urldecode(decodedPath, originalPath);
-    path = string(decodedPath);
-    delete []decodedPath;
+// Streamed files only have Last-Modified, since their ETag would need a full read
+bool __isNotModified(const router::Response &response, const websocketpp::http::parser::request &request) {
+    auto etag = response.headers.find("ETag");
+    auto lastModified = response.headers.find("Last-Modified");
+    // If-None-Match takes precedence over If-Modified-Since
+    const string &ifNoneMatch = request.get_header("If-None-Match");
+    if(!ifNoneMatch.empty()) {
+        return etag != response.headers.end() &&
+            (ifNoneMatch == "*" || ifNoneMatch.find(etag->second) != string::npos);
+    }
+    const string &ifModifiedSince = request.get_header("If-Modified-Since");
+    return lastModified != response.headers.end() && !ifModifiedSince.empty() &&
+        ifModifiedSince == lastModified->second;
+}
+
+// A range request with If-Range gets the partial content only if the asset is
+// unchanged, i.e., the validator matches the current ETag or Last-Modified
+bool __isRangeValid(const router::Response &response, const websocketpp::http::parser::request &request) {
+    const string &ifRange = request.get_header("If-Range");
+    if(ifRange.empty()) {
+        return true;
+    }
+    for(const char *header: {"ETag", "Last-Modified"}) {
+        auto validator = response.headers.find(header);
+        if(validator != response.headers.end() && validator->second == ifRange) {
+            return true;
+        }
+    }
+    return false;
+}
 
+router::Response serve(string path, const websocketpp::http::parser::request &request) {
     // Ignore query params
-    path = path.substr(0, path.find("?"));
+    path = urlparser::decode(urlparser::parse(path).path);
 
-    bool isClientLibrary = regex_match(path, regex(".*neutralino.js$"));
-    bool isGlobalsRequest = regex_match(path, regex(".*__neutralino_globals.js$"));
+    bool isClientLibrary = helpers::endsWith(path, "neutralino.js");
+    bool isGlobalsRequest = helpers::endsWith(path, "__neutralino_globals.js");
 
     if(isClientLibrary) {
         return getAsset(path, settings::getGlobalVars());
     }
     else if(isGlobalsRequest) {
-        return router::Response {
-            websocketpp::http::status_code::ok,
-            "application/javascript",
-            settings::getGlobalVars()
-        };
+        router::Response response;
+        response.contentType = "application/javascript";
+        response.data = settings::getGlobalVars();
+        return response;
     }
-    else {
-        return getAsset(path);
+
+    const string &acceptEncoding = request.get_header("Accept-Encoding");
+    router::Response response = getAsset(path, "", request.get_header("Range"), acceptEncoding);
+    if(response.status == websocketpp::http::status_code::partial_content && !__isRangeValid(response, request)) {
+        response = getAsset(path, "", "", acceptEncoding);
     }
+    if(response.status == websocketpp::http::status_code::ok && __isNotModified(response, request)) {
+        response.status = websocketpp::http::status_code::not_modified;
+        response.data.clear();
+        response.dataView = string_view();
+        response.dataOwner = nullptr;
+        response.bodyFilename.clear();
+    }
+    return response;
 }
 
 } // namespace router
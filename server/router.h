@@ -2,11 +2,20 @@
 #define NEU_ROUTER_H
 
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <map>
 
 #include <websocketpp/server.hpp>
+#include <websocketpp/http/request.hpp>
 
 #include "lib/json/json.hpp"
 #include "errors.h"
+#include "server/assetcache.h"
 
 using namespace std;
 using json = nlohmann::json;
@@ -19,6 +28,15 @@ struct Response {
     websocketpp::http::status_code::value status = websocketpp::http::status_code::ok;
     string contentType = "application/octet-stream";
     string data;
+    // Sent instead of data if set, so cached and bundled assets are not copied
+    // per response. dataOwner keeps cached data alive, the bundle never goes away.
+    string_view dataView;
+    assetcache::AssetPtr dataOwner;
+    // Streamed from the disk if set, so files too large for the asset cache
+    // are not read into memory
+    string bodyFilename;
+    long long bodySize = 0;
+    map<string, string> headers;
 };
 
 struct NativeMessage {
@@ -26,12 +44,58 @@ struct NativeMessage {
     string method;
     string accessToken;
     json data;
+    // The connection that sent the request, empty for internal calls
+    websocketpp::connection_hdl connection;
 };
 
-router::Response serve(string path);
+typedef function<void(const router::NativeMessage &)> NativeResponseHandler;
+
+// An in-flight native call. Controllers can defer the response of the current
+// call and complete it later from another thread via router::completeCall.
+struct NativeCall {
+    string id;
+    string method;
+    websocketpp::connection_hdl connection;
+    atomic<bool> deferred{false};
+    atomic<bool> completed{false};
+    atomic<bool> cancelled{false};
+    router::NativeResponseHandler responseHandler;
+    function<void()> cancelHandler;
+    mutex cancelHandlerLock;
+};
+
+typedef shared_ptr<router::NativeCall> NativeCallPtr;
+
+// A slot of the precompiled dispatch table. Permissions and dispatch flags are
+// resolved once by router::init, so native calls don't consult the config.
+struct NativeMethodEntry {
+    string name;
+    uint64_t hash = 0;
+    router::NativeMethod method = nullptr;
+    bool allowed = false;
+    bool windowOnly = false;
+    bool mainThread = false;
+    bool async = false;
+};
+
+void init();
+const router::NativeMethodEntry *findNativeMethod(string_view method);
+
+router::Response serve(string path, const websocketpp::http::parser::request &request);
 router::NativeMessage executeNativeMethod(const router::NativeMessage &request);
-router::Response getAsset(string path, const string &prependData = "");
-map<string, router::NativeMethod> getMethodMap();
+void executeNativeMethod(const router::NativeMessage &request, const router::NativeResponseHandler &responseHandler);
+bool isAsyncMethod(const string &method);
+bool isAsyncRequest(const router::NativeMessage &request);
+router::NativeCallPtr deferCurrentCall();
+bool completeCall(const router::NativeCallPtr &call, const json &output);
+void setCancelHandler(const router::NativeCallPtr &call, const function<void()> &cancelHandler);
+bool cancelCall(const websocketpp::connection_hdl &connection, const string &id);
+bool isCurrentCallCancelled();
+websocketpp::connection_hdl getCurrentConnection();
+router::Response getAsset(string path, const string &prependData = "", const string &range = "",
+    const string &acceptEncoding = "");
+void prefetchAssets();
+const map<string, router::NativeMethod> &getMethodMap();
 errors::StatusCode mountPath(string &path, string &target);
 bool isMounted(const string &path);
 bool unmountPath(string &path);
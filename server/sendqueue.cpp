@@ -0,0 +1,298 @@
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "lib/json/json.hpp"
+#include "server/sendqueue.h"
+#include "settings.h"
+#include "api/debug/debug.h"
+
+#define NEU_DEFAULT_SEND_QUEUE_SIZE 8388608
+#define NEU_SEND_QUEUE_BLOCK_TIMEOUT 10000
+#define NEU_SEND_QUEUE_HARD_LIMIT_FACTOR 4
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace sendqueue {
+
+size_t maxQueueSize = NEU_DEFAULT_SEND_QUEUE_SIZE;
+// Events that can't be dropped may exceed the queue size while the producer
+// can't wait (i.e., on the I/O threads), but not this limit
+size_t maxHardQueueSize = NEU_DEFAULT_SEND_QUEUE_SIZE * NEU_SEND_QUEUE_HARD_LIMIT_FACTOR;
+sendqueue::Policy defaultPolicy = sendqueue::PolicyDropOldest;
+// Process output and file streams lose data if dropped, so they slow down the
+// producer instead. Other events are usually stale by the time a client catches up.
+map<string, sendqueue::Policy> policies = {
+    {"spawnedProcess", sendqueue::PolicyMergeStdout},
+    {"openedFile", sendqueue::PolicyBlock}
+};
+
+bool __parsePolicy(const json &jPolicy, sendqueue::Policy &policy) {
+    if(!jPolicy.is_string()) {
+        return false;
+    }
+    string name = jPolicy.get<string>();
+    if(name == "block") policy = sendqueue::PolicyBlock;
+    else if(name == "dropOldest") policy = sendqueue::PolicyDropOldest;
+    else if(name == "coalesceLatest") policy = sendqueue::PolicyCoalesceLatest;
+    else if(name == "mergeStdout") policy = sendqueue::PolicyMergeStdout;
+    else return false;
+    return true;
+}
+
+size_t __getSize(const sendqueue::Message &message) {
+    return message.size;
+}
+
+// Frames merged events, which are framed only once when they are sent
+const websocketserver::message_ptr &__getFrame(const sendqueue::QueuePtr &queue, sendqueue::Message &message) {
+    if(!message.frame) {
+        message.frame = queue->framer(message.mergedContent);
+        message.mergedContent = json();
+    }
+    return message.frame;
+}
+
+const json &__getEventData(const sendqueue::Message &message) {
+    static const json empty;
+    if(message.content && message.content->contains("data")) {
+        return (*message.content)["data"];
+    }
+    return empty;
+}
+
+bool __isDroppable(const sendqueue::Message &message) {
+    sendqueue::Policy policy = sendqueue::getPolicy(message.event);
+    return policy == sendqueue::PolicyDropOldest || policy == sendqueue::PolicyCoalesceLatest;
+}
+
+// Drops the oldest events that allow dropping until the new event fits.
+// Returns false if the queue is still full.
+bool __dropOldest(const sendqueue::QueuePtr &queue, size_t requiredSize) {
+    for(auto it = queue->messages.begin(); it != queue->messages.end() &&
+        queue->stats.queuedBytes + requiredSize > maxQueueSize;) {
+        if(!__isDroppable(*it)) {
+            ++it;
+            continue;
+        }
+        queue->stats.queuedBytes -= __getSize(*it);
+        it = queue->messages.erase(it);
+        queue->stats.queuedMessages--;
+        queue->stats.dropped++;
+    }
+    return queue->stats.queuedBytes + requiredSize <= maxQueueSize;
+}
+
+// Replaces the queued event with the same name and id with the latest one
+void __coalesce(const sendqueue::QueuePtr &queue, const sendqueue::Message &message) {
+    const json &data = __getEventData(message);
+    json id = data.is_object() && data.contains("id") ? data["id"] : json();
+    for(auto it = queue->messages.begin(); it != queue->messages.end(); ++it) {
+        const json &queuedData = __getEventData(*it);
+        json queuedId = queuedData.is_object() && queuedData.contains("id") ? queuedData["id"] : json();
+        if(it->event == message.event && queuedId == id) {
+            queue->stats.queuedBytes -= __getSize(*it);
+            queue->messages.erase(it);
+            queue->stats.queuedMessages--;
+            queue->stats.coalesced++;
+            return;
+        }
+    }
+}
+
+bool __isOutputChunk(const json &data) {
+    return data.is_object() && data.contains("action") && data.contains("data") &&
+            (data["data"].is_string() || data["data"].is_binary()) &&
+            (data["action"] == "stdOut" || data["action"] == "stdErr");
+}
+
+// Appends an output chunk to the last queued chunk of the same process and stream.
+// The chunks are appended in place, the merged event is framed when it's sent.
+bool __merge(const sendqueue::QueuePtr &queue, const sendqueue::Message &message) {
+    if(queue->messages.empty() || !queue->framer) {
+        return false;
+    }
+    sendqueue::Message &last = queue->messages.back();
+    const json &data = __getEventData(message);
+    const json &lastData = __getEventData(last);
+    if(last.event != message.event || !__isOutputChunk(data) || !__isOutputChunk(lastData) ||
+        data["action"] != lastData["action"] || data.value("id", json()) != lastData.value("id", json()) ||
+        data["data"].type() != lastData["data"].type()) {
+        return false;
+    }
+    if(last.frame) {
+        last.mergedContent = *last.content;
+        last.frame = nullptr;
+    }
+    json &mergedData = last.mergedContent["data"]["data"];
+    if(data["data"].is_binary()) {
+        json::binary_t &bytes = mergedData.get_binary();
+        const json::binary_t &chunk = data["data"].get_binary();
+        bytes.insert(bytes.end(), chunk.begin(), chunk.end());
+    }
+    else {
+        mergedData.get_ref<string &>() += data["data"].get_ref<const string &>();
+    }
+    // Counts the whole event of the chunk, so the queue size is a bit overestimated
+    last.size += __getSize(message);
+    queue->stats.queuedBytes += __getSize(message);
+    queue->stats.merged++;
+    return true;
+}
+
+void init() {
+    json jQueueSize = settings::getOptionForCurrentMode("wsSendQueueSize");
+    if(jQueueSize.is_number_integer() && jQueueSize.get<long long>() >= 0) {
+        maxQueueSize = jQueueSize.get<size_t>();
+    }
+    if(maxQueueSize == 0) {
+        maxQueueSize = SIZE_MAX;
+    }
+    maxHardQueueSize = maxQueueSize > SIZE_MAX / NEU_SEND_QUEUE_HARD_LIMIT_FACTOR ?
+        SIZE_MAX : maxQueueSize * NEU_SEND_QUEUE_HARD_LIMIT_FACTOR;
+
+    json jPolicies = settings::getOptionForCurrentMode("wsSendQueuePolicies");
+    if(!jPolicies.is_object()) {
+        return;
+    }
+    for(const auto &[event, jPolicy]: jPolicies.items()) {
+        sendqueue::Policy policy;
+        if(!__parsePolicy(jPolicy, policy)) {
+            debug::log(debug::LogTypeWarning, "Unknown WebSocket send queue policy for " + event);
+            continue;
+        }
+        if(event == "*") {
+            defaultPolicy = policy;
+        }
+        else {
+            policies[event] = policy;
+        }
+    }
+}
+
+sendqueue::QueuePtr makeQueue(const sendqueue::MessageFramer &framer) {
+    sendqueue::QueuePtr queue = make_shared<sendqueue::Queue>();
+    queue->framer = framer;
+    return queue;
+}
+
+sendqueue::Policy getPolicy(const string &event) {
+    auto it = policies.find(event);
+    return it != policies.end() ? it->second : defaultPolicy;
+}
+
+bool isBlocking(sendqueue::Policy policy) {
+    return policy == sendqueue::PolicyBlock || policy == sendqueue::PolicyMergeStdout;
+}
+
+// Sends the event right away if nothing is queued and the connection has
+// room, otherwise queues it. Returns true if the event was queued.
+bool push(const sendqueue::QueuePtr &queue, sendqueue::Message &&message,
+    const sendqueue::CapacityChecker &hasCapacity, const sendqueue::MessageSender &send) {
+    lock_guard<mutex> guard(queue->lock);
+    if(queue->closed) {
+        return false;
+    }
+    if(queue->messages.empty() && hasCapacity()) {
+        send(message.frame);
+        return false;
+    }
+
+    message.size = message.frame->get_payload().size();
+    size_t size = __getSize(message);
+    sendqueue::Policy policy = sendqueue::getPolicy(message.event);
+    if(policy == sendqueue::PolicyCoalesceLatest) {
+        __coalesce(queue, message);
+    }
+    if(policy == sendqueue::PolicyMergeStdout && queue->stats.queuedBytes + size <= maxQueueSize &&
+        __merge(queue, message)) {
+        return true;
+    }
+
+    if(queue->stats.queuedBytes + size > maxQueueSize) {
+        bool wasDropping = queue->stats.dropped > 0;
+        bool fits = __dropOldest(queue, size);
+        // Events that can't be dropped are queued even if the queue stays full,
+        // the producer waits for the queue to drain after the broadcast instead.
+        // Producers that can't wait would grow the queue without bound, so these
+        // events are dropped too once the queue reaches the hard limit.
+        bool overflowed = sendqueue::isBlocking(policy) && size > maxHardQueueSize - queue->stats.queuedBytes;
+        bool dropped = (!fits && !sendqueue::isBlocking(policy)) || overflowed;
+        if(dropped) {
+            queue->stats.dropped++;
+        }
+        if(overflowed && !queue->overflowed) {
+            queue->overflowed = true;
+            debug::log(debug::LogTypeError, "WebSocket client is too slow, dropping " + message.event +
+                " events after reaching the send queue limit of " + to_string(maxHardQueueSize) + " bytes");
+        }
+        else if(!wasDropping && queue->stats.dropped > 0) {
+            debug::log(debug::LogTypeWarning, "WebSocket client is too slow, dropping queued events");
+        }
+        if(dropped) {
+            return false;
+        }
+    }
+    queue->stats.queuedBytes += size;
+    queue->stats.queuedMessages++;
+    queue->messages.push_back(move(message));
+    return true;
+}
+
+// Waits until the queues are back within their size limit. Waiting stalls the
+// producer (i.e., a process output reader), so the data waits in the pipe
+// instead of memory. All queues share one timeout, so slow clients can't stall
+// the producer for long, and each slow client doesn't add to the wait.
+void waitForCapacity(const vector<sendqueue::QueuePtr> &queues) {
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(NEU_SEND_QUEUE_BLOCK_TIMEOUT);
+    for(const sendqueue::QueuePtr &queue: queues) {
+        unique_lock<mutex> guard(queue->lock);
+        if(queue->closed || queue->stats.queuedBytes <= maxQueueSize) {
+            continue;
+        }
+        queue->stats.blocked++;
+        queue->drained.wait_until(guard, deadline, [&]() {
+            return queue->closed || queue->stats.queuedBytes <= maxQueueSize;
+        });
+    }
+}
+
+// Hands queued events to the connection while it has room.
+// Returns true if events are still waiting.
+bool flush(const sendqueue::QueuePtr &queue, const sendqueue::CapacityChecker &hasCapacity,
+    const sendqueue::MessageSender &send) {
+    bool sent = false;
+    lock_guard<mutex> guard(queue->lock);
+    while(!queue->messages.empty() && hasCapacity()) {
+        sendqueue::Message &message = queue->messages.front();
+        send(__getFrame(queue, message));
+        queue->stats.queuedBytes -= __getSize(message);
+        queue->stats.queuedMessages--;
+        queue->messages.pop_front();
+        sent = true;
+    }
+    if(sent) {
+        queue->drained.notify_all();
+    }
+    return !queue->messages.empty();
+}
+
+void close(const sendqueue::QueuePtr &queue) {
+    lock_guard<mutex> guard(queue->lock);
+    queue->closed = true;
+    queue->messages.clear();
+    queue->stats.queuedBytes = 0;
+    queue->stats.queuedMessages = 0;
+    queue->drained.notify_all();
+}
+
+sendqueue::Stats getStats(const sendqueue::QueuePtr &queue) {
+    lock_guard<mutex> guard(queue->lock);
+    return queue->stats;
+}
+
+} // namespace sendqueue
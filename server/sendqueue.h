@@ -0,0 +1,74 @@
+#ifndef NEU_SENDQUEUE_H
+#define NEU_SENDQUEUE_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "lib/json/json.hpp"
+#include "server/wsconfig.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace sendqueue {
+
+// What to do with an event when the connection's queue is full
+enum Policy { PolicyBlock, PolicyDropOldest, PolicyCoalesceLatest, PolicyMergeStdout };
+
+// A queued event. The frame is shared with the other recipients of the
+// broadcast until the queue rewrites the event (i.e., merges stdout chunks).
+// Merged chunks are appended to mergedContent and framed once when sent.
+struct Message {
+    string event;
+    shared_ptr<const json> content;
+    websocketserver::message_ptr frame;
+    json mergedContent;
+    size_t size = 0;
+};
+
+struct Stats {
+    size_t queuedBytes = 0;
+    size_t queuedMessages = 0;
+    uint64_t dropped = 0;
+    uint64_t coalesced = 0;
+    uint64_t merged = 0;
+    uint64_t blocked = 0;
+};
+
+typedef function<websocketserver::message_ptr(const json &)> MessageFramer;
+typedef function<bool()> CapacityChecker;
+typedef function<void(const websocketserver::message_ptr &)> MessageSender;
+
+struct Queue {
+    deque<sendqueue::Message> messages;
+    sendqueue::Stats stats;
+    sendqueue::MessageFramer framer;
+    bool closed = false;
+    bool overflowed = false;
+    mutex lock;
+    condition_variable drained;
+};
+
+typedef shared_ptr<sendqueue::Queue> QueuePtr;
+
+void init();
+sendqueue::QueuePtr makeQueue(const sendqueue::MessageFramer &framer);
+sendqueue::Policy getPolicy(const string &event);
+bool isBlocking(sendqueue::Policy policy);
+bool push(const sendqueue::QueuePtr &queue, sendqueue::Message &&message,
+    const sendqueue::CapacityChecker &hasCapacity, const sendqueue::MessageSender &send);
+void waitForCapacity(const vector<sendqueue::QueuePtr> &queues);
+bool flush(const sendqueue::QueuePtr &queue, const sendqueue::CapacityChecker &hasCapacity,
+    const sendqueue::MessageSender &send);
+void close(const sendqueue::QueuePtr &queue);
+sendqueue::Stats getStats(const sendqueue::QueuePtr &queue);
+
+} // namespace sendqueue
+
+#endif // #define NEU_SENDQUEUE_H
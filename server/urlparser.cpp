@@ -0,0 +1,73 @@
+#include <string>
+#include <string_view>
+#include <optional>
+
+#include "server/urlparser.h"
+
+using namespace std;
+
+namespace urlparser {
+
+int __hexToInt(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+urlparser::URL parse(string_view url) {
+    urlparser::URL parsedUrl;
+    size_t fragmentPos = url.find('#');
+    if(fragmentPos != string_view::npos) {
+        parsedUrl.fragment = url.substr(fragmentPos + 1);
+        url = url.substr(0, fragmentPos);
+    }
+    size_t queryPos = url.find('?');
+    if(queryPos != string_view::npos) {
+        parsedUrl.query = url.substr(queryPos + 1);
+        url = url.substr(0, queryPos);
+    }
+    parsedUrl.path = url;
+    return parsedUrl;
+}
+
+optional<string_view> getQueryParam(string_view url, string_view key) {
+    string_view query = urlparser::parse(url).query;
+    while(!query.empty()) {
+        size_t separatorPos = query.find('&');
+        string_view param = query.substr(0, separatorPos);
+        size_t equalPos = param.find('=');
+        if(param.substr(0, equalPos) == key) {
+            return equalPos == string_view::npos ? string_view() : param.substr(equalPos + 1);
+        }
+        if(separatorPos == string_view::npos) {
+            break;
+        }
+        query.remove_prefix(separatorPos + 1);
+    }
+    return nullopt;
+}
+
+bool hasQueryParam(string_view url, string_view key) {
+    return urlparser::getQueryParam(url, key).has_value();
+}
+
+string decode(string_view value) {
+    string decoded;
+    decoded.reserve(value.size());
+    for(size_t i = 0; i < value.size(); i++) {
+        if(value[i] == '%' && i + 2 < value.size()) {
+            int high = __hexToInt(value[i + 1]);
+            int low = __hexToInt(value[i + 2]);
+            if(high >= 0 && low >= 0) {
+                decoded += (char) (high * 16 + low);
+                i += 2;
+                continue;
+            }
+        }
+        decoded += value[i];
+    }
+    return decoded;
+}
+
+} // namespace urlparser
@@ -0,0 +1,26 @@
+#ifndef NEU_URLPARSER_H
+#define NEU_URLPARSER_H
+
+#include <string>
+#include <string_view>
+#include <optional>
+
+using namespace std;
+
+namespace urlparser {
+
+// Views into the original URL string, nothing is copied
+struct URL {
+    string_view path;
+    string_view query;
+    string_view fragment;
+};
+
+urlparser::URL parse(string_view url);
+optional<string_view> getQueryParam(string_view url, string_view key);
+bool hasQueryParam(string_view url, string_view key);
+string decode(string_view value);
+
+} // namespace urlparser
+
+#endif // #define NEU_URLPARSER_H
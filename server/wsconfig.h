@@ -0,0 +1,50 @@
+#ifndef NEU_WSCONFIG_H
+#define NEU_WSCONFIG_H
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#if defined(NEU_HAS_ZLIB)
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#endif
+
+namespace wsconfig {
+
+#if defined(NEU_HAS_ZLIB)
+
+typedef websocketpp::extensions::permessage_deflate::enabled
+    <websocketpp::config::asio::permessage_deflate_config> deflateExtensionBase;
+
+// websocketpp negotiates extensions with every client that offers them,
+// so the deflate extension declines offers unless compression is enabled
+class deflateExtension : public deflateExtensionBase {
+public:
+    static inline bool negotiable = false;
+
+    websocketpp::err_str_pair negotiate(const websocketpp::http::attribute_list &offer) {
+        if(!negotiable) {
+            return websocketpp::err_str_pair(websocketpp::extensions::permessage_deflate::error::make_error_code(
+                websocketpp::extensions::permessage_deflate::error::general), "");
+        }
+        return deflateExtensionBase::negotiate(offer);
+    }
+};
+
+struct asio : public websocketpp::config::asio {
+    typedef asio type;
+    typedef websocketpp::config::asio base;
+
+    typedef deflateExtension permessage_deflate_type;
+};
+
+#else
+
+typedef websocketpp::config::asio asio;
+
+#endif
+
+} // namespace wsconfig
+
+typedef websocketpp::server<wsconfig::asio> websocketserver;
+
+#endif // #define NEU_WSCONFIG_H
@@ -247,8 +247,10 @@ void setGlobalArgs(const json &args) {
 }
 
 settings::AppMode getMode() {
-    string mode = !options["defaultMode"].is_null() ?
-                    options["defaultMode"].get<string>() : "window";
+    // Native methods run concurrently on server workers, so read options
+    // without the inserting (non-const) json::operator[]
+    string mode = options.contains("defaultMode") && !options.at("defaultMode").is_null() ?
+                    options.at("defaultMode").get<string>() : "window";
     if(mode == "window") return settings::AppModeWindow;
     if(mode == "browser") return settings::AppModeBrowser;
     if(mode == "cloud") return settings::AppModeCloud;
@@ -370,9 +372,16 @@ void applyConfigOverride(const settings::CliArg &arg) {
 // Priority: mode -> root -> null
 json getOptionForCurrentMode(const string &key) {
     string mode = helpers::appModeToStr(settings::getMode());
-    json value = options["modes"][mode][key];
-    if(value.is_null()) {
-        value = options[key];
+    json value = nullptr;
+    if(!options.is_object()) {
+        return value;
+    }
+    if(options.contains("modes") && options.at("modes").contains(mode)
+        && options.at("modes").at(mode).contains(key)) {
+        value = options.at("modes").at(mode).at(key);
+    }
+    if(value.is_null() && options.contains(key)) {
+        value = options.at(key);
     }
     return value;
 }
@@ -209,4 +209,74 @@ describe('app.spec: app namespace tests', () => {
             assert.strictEqual(output.order[1], 2);
         });    
     });
+
+    describe('app.cancelCall', () => {
+        it('rejects a cancelled call and keeps the connection usable', async () => {
+            runner.run(`
+                const call = await __connect();
+                const slow = call('os.execCommand', { command: 'node -e "setTimeout(() => {}, 15000)"' }, 'slow');
+                await new Promise((resolve) => setTimeout(resolve, 500));
+                const cancelled = await call('app.cancelCall', { id: 'slow' });
+                const response = await slow;
+                const next = await call('os.execCommand', { command: 'node --version' });
+                const cancelledAgain = await call('app.cancelCall', { id: 'slow' });
+                await __close(JSON.stringify({ cancelled, response, next, cancelledAgain }));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.ok(output.cancelled.success);
+            assert.equal(output.response.error.code, 'NE_RT_NATCNCL');
+            assert.equal(output.next.returnValue.stdOut.charAt(0), 'v');
+            assert.equal(output.cancelledAgain.error.code, 'NE_RT_NOCALLE');
+        });
+
+        it('completes long-running calls out of order', async () => {
+            runner.run(`
+                const call = await __connect();
+                const order = [];
+                const slow = call('os.execCommand', { command: 'node -e "setTimeout(() => {}, 2000)"' })
+                    .then(() => order.push('slow'));
+                const fast = call('os.execCommand', { command: 'node --version' })
+                    .then(() => order.push('fast'));
+                await Promise.all([slow, fast]);
+                await __close(JSON.stringify(order));
+            `);
+            assert.deepEqual(JSON.parse(runner.getOutput()), ['fast', 'slow']);
+        });
+
+        it('stops reading a directory tree once the call is cancelled', async () => {
+            runner.run(`
+                const call = await __connect();
+                const root = NL_PATH + '/.tmp/tree';
+                const scriptPath = NL_PATH + '/.tmp/make_tree.js';
+                await Neutralino.filesystem.writeFile(scriptPath, [
+                    "const fs = require('fs');",
+                    "for(let i = 0; i < 100; i++) {",
+                    "    fs.mkdirSync(process.argv[2] + '/' + i, { recursive: true });",
+                    "    for(let j = 0; j < 100; j++) fs.writeFileSync(process.argv[2] + '/' + i + '/' + j, '');",
+                    "}"
+                ].join('\\n'));
+                await call('os.execCommand', { command: 'node "' + scriptPath + '" "' + root + '"' });
+                // One of the default four native worker threads stays free for app.cancelCall
+                const ids = ['read-0', 'read-1', 'read-2'];
+                const reads = ids.map((id) => call('filesystem.readDirectory', { path: root, recursive: true }, id));
+                const cancelled = await Promise.all(ids.map((id) => call('app.cancelCall', { id })));
+                const responses = await Promise.all(reads);
+                const next = await call('filesystem.getStats', { path: root });
+                await __close(JSON.stringify({ cancelled, responses, next }));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            // A walk can finish before its cancel message arrives
+            output.cancelled.forEach((result, i) => {
+                if(result.success) {
+                    assert.equal(output.responses[i].error.code, 'NE_RT_NATCNCL');
+                }
+                else {
+                    assert.equal(result.error.code, 'NE_RT_NOCALLE');
+                    assert.equal(output.responses[i].returnValue.length, 10100);
+                }
+            });
+            assert.ok(output.cancelled.some((result) => result.success));
+            assert.ok(output.next.returnValue.isDirectory);
+        });
+    });
 });
@@ -406,4 +406,43 @@ describe('events.spec: events namespace tests', () => {
             assert.strictEqual(output, true);
         });         
     });
+
+    describe('subscribe', () => {
+        it('only sends subscribed events to a connection after it subscribes', async () => {
+            runner.run(`
+                const response = {};
+                const call = await __connect();
+                const wait = () => new Promise((resolve) => setTimeout(resolve, 500));
+
+                await Neutralino.events.broadcast('specEventA');
+                await wait();
+                response.before = call.events.filter((event) => event.startsWith('spec'));
+                call.events.length = 0;
+
+                const subscribed = await call('subscribe', { events: ['specEventB', 'specPrefix*'] });
+                response.topics = subscribed.returnValue;
+                await Neutralino.events.broadcast('specEventA');
+                await Neutralino.events.broadcast('specEventB');
+                await Neutralino.events.broadcast('specPrefixC');
+                await wait();
+                response.subscribed = call.events.filter((event) => event.startsWith('spec'));
+                call.events.length = 0;
+
+                await call('unsubscribe', { events: ['specEventB'] });
+                await Neutralino.events.broadcast('specEventB');
+                await Neutralino.events.broadcast('specPrefixD');
+                await wait();
+                response.unsubscribed = call.events.filter((event) => event.startsWith('spec'));
+
+                response.missingEvents = (await call('subscribe', {})).error.code;
+                await __close(JSON.stringify(response));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.deepEqual(output.before, ['specEventA'], 'Expected all events before subscribing');
+            assert.deepEqual(output.topics.sort(), ['specEventB', 'specPrefix*']);
+            assert.deepEqual(output.subscribed, ['specEventB', 'specPrefixC'], 'Expected only subscribed events');
+            assert.deepEqual(output.unsubscribed, ['specPrefixD'], 'Expected no events after unsubscribing');
+            assert.equal(output.missingEvents, 'NE_RT_NATRTER');
+        });
+    });
 });
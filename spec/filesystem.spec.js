@@ -881,6 +881,30 @@ describe('filesystem.spec: filesystem namespace tests', () => {
             assert.equal(runner.getOutput(), 'Hello Content');
         });
 
+        it('keeps the order of file changes that are not awaited', async () => {
+            runner.run(`
+                const dir = NL_PATH + '/.tmp';
+                const calls = [];
+                for(let i = 0; i < 20; i++) {
+                    calls.push(Neutralino.filesystem.writeFile(dir + '/order_' + i + '.txt', 'Hello ' + i));
+                    calls.push(Neutralino.filesystem.move(dir + '/order_' + i + '.txt', dir + '/moved_' + i + '.txt'));
+                    calls.push(Neutralino.filesystem.copy(dir + '/moved_' + i + '.txt', dir + '/copied_' + i + '.txt'));
+                    calls.push(Neutralino.filesystem.remove(dir + '/moved_' + i + '.txt'));
+                }
+                const results = await Promise.allSettled(calls);
+                const errors = results.filter((result) => result.status == 'rejected')
+                    .map((result) => result.reason.code);
+                const content = await Neutralino.filesystem.readFile(dir + '/copied_19.txt');
+                const entries = await Neutralino.filesystem.readDirectory(dir);
+                const moved = entries.filter((entry) => entry.entry.startsWith('moved_')).length;
+                await __close(JSON.stringify({ errors, content, moved }));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.deepEqual(output.errors, []);
+            assert.equal(output.content, 'Hello 19');
+            assert.equal(output.moved, 0);
+        });
+
         it('throws an error when moving to a non-existent directory', async () => {
             runner.run(`
                 await Neutralino.filesystem.writeFile(NL_PATH + '/.tmp/test_new.txt', 'Hello');
@@ -2,6 +2,25 @@ const assert = require('assert');
 const runner = require('./runner');
 const path = require('path');
 
+// Process pool methods are sent as native messages with __connect, since
+// app.cancelCall only cancels calls of its own connection. The worker echoes
+// JSON lines, exits on the crash op, and answers the sleep op late.
+const POOL_HELPERS = `
+    async function __createPool(call, size) {
+        const workerPath = NL_PATH + '/.tmp/pool_worker.js';
+        await Neutralino.filesystem.writeFile(workerPath, [
+            "require('readline').createInterface({ input: process.stdin }).on('line', (line) => {",
+            "    const request = JSON.parse(line);",
+            "    if(request.op == 'crash') process.exit(3);",
+            "    const response = JSON.stringify({ pid: process.pid, echo: request }) + '\\\\n';",
+            "    setTimeout(() => process.stdout.write(response), request.op == 'sleep' ? 5000 : 0);",
+            "});"
+        ].join('\\n'));
+        const result = await call('os.createProcessPool', { command: 'node "' + workerPath + '"', size });
+        return result.returnValue.id;
+    }
+`;
+
 describe('os.spec: os namespace tests', () => {
 
     describe('os.execCommand', () => {
@@ -54,6 +73,49 @@ describe('os.spec: os namespace tests', () => {
             assert.ok(info.exitCode == 0);
             assert.ok(info.stdOut.includes('v'));
         });
+
+        it('keeps the head and the tail of the output with maxOutputBytes', async () => {
+            runner.run(`
+                let info = await Neutralino.os.execCommand(
+                    'node -e "process.stdout.write(Buffer.alloc(100, 97).toString() + Buffer.alloc(100, 98).toString())"',
+                    { maxOutputBytes: 10 });
+                await __close(JSON.stringify(info));
+            `);
+            const info = JSON.parse(runner.getOutput());
+            assert.equal(info.stdOut, 'aaaaabbbbb');
+            assert.ok(info.stdOutTruncated);
+            assert.ok(!info.stdErrTruncated);
+        });
+
+        it('kills the command after the timeout', async () => {
+            runner.run(`
+                let info = await Neutralino.os.execCommand('node -e "setTimeout(() => {}, 10000)"', { timeout: 500 });
+                await __close(JSON.stringify(info));
+            `);
+            const info = JSON.parse(runner.getOutput());
+            assert.ok(info.timedOut);
+        });
+
+        it('kills commands and their children that ignore termination after the timeout', async () => {
+            runner.run(`
+                const script = NL_PATH + '/.tmp/ignore-term.js';
+                await Neutralino.filesystem.createDirectory(NL_PATH + '/.tmp').catch(() => {});
+                await Neutralino.filesystem.writeFile(script, [
+                    "process.on('SIGTERM', () => {});",
+                    "if(!process.argv[2]) {",
+                    "    require('child_process').spawn(process.execPath, [__filename, 'child'], { stdio: 'inherit' });",
+                    "}",
+                    "setTimeout(() => {}, 20000);"
+                ].join('\\n'));
+                const start = Date.now();
+                let info = await Neutralino.os.execCommand('node "' + script + '"', { timeout: 500 });
+                info.elapsed = Date.now() - start;
+                await __close(JSON.stringify(info));
+            `);
+            const info = JSON.parse(runner.getOutput());
+            assert.ok(info.timedOut);
+            assert.ok(info.elapsed < 10000, 'Expected the command and its child to be killed after the grace period');
+        });
     });
 
 
@@ -133,6 +195,20 @@ describe('os.spec: os namespace tests', () => {
             assert.ok(output.length > 0);
         });
 
+        it('sends complete lines with the line output mode', async () => {
+            runner.run(`
+                let proc = await Neutralino.os.spawnProcess(
+                    'node -e "process.stdout.write(String.fromCharCode(97)); setTimeout(() => console.log(String.fromCharCode(98)), 200);"',
+                    { outputMode: 'line' });
+                Neutralino.events.on('spawnedProcess', async (evt) => {
+                    if(evt.detail.id == proc.id && evt.detail.action == 'stdOut') {
+                        await __close(JSON.stringify(evt.detail.data));
+                    }
+                });
+            `);
+            assert.equal(JSON.parse(runner.getOutput()), 'ab\n');
+        });
+
         it('handles long-running processes', async () => {
             runner.run(`
                 let proc = await Neutralino.os.spawnProcess('node -e "setInterval(() => console.log(\\\\"running\\\\"), 1000);"');
@@ -304,6 +380,93 @@ describe('os.spec: os namespace tests', () => {
         }); 
     });
 
+    describe('os.createProcessPool', () => {
+        it('sends requests to the workers and returns their responses', async () => {
+            runner.run(POOL_HELPERS + `
+                const call = await __connect();
+                const poolId = await __createPool(call, 2);
+                const responses = await Promise.all([1, 2, 3, 4].map((x) =>
+                    call('os.callProcessPool', { id: poolId, data: { x } })));
+                await call('os.destroyProcessPool', { id: poolId });
+                await __close(JSON.stringify(responses));
+            `);
+            const responses = JSON.parse(runner.getOutput());
+            assert.deepEqual(responses.map((response) => response.returnValue.echo.x), [1, 2, 3, 4]);
+            assert.ok(new Set(responses.map((response) => response.returnValue.pid)).size <= 2);
+        });
+
+        it('restarts a worker that exits and fails its request', async () => {
+            runner.run(POOL_HELPERS + `
+                const call = await __connect();
+                const poolId = await __createPool(call, 1);
+                const crashed = await call('os.callProcessPool', { id: poolId, data: { op: 'crash' } });
+                const next = await call('os.callProcessPool', { id: poolId, data: { x: 1 } });
+                await call('os.destroyProcessPool', { id: poolId });
+                await __close(JSON.stringify({ crashed, next }));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.equal(output.crashed.error.code, 'NE_OS_PRWKEXT');
+            assert.equal(output.next.returnValue.echo.x, 1);
+        });
+
+        it('cancels a request with app.cancelCall', async () => {
+            runner.run(POOL_HELPERS + `
+                const call = await __connect();
+                const poolId = await __createPool(call, 1);
+                const slow = call('os.callProcessPool', { id: poolId, data: { op: 'sleep' } }, 'slow');
+                const queued = call('os.callProcessPool', { id: poolId, data: { x: 1 } }, 'queued');
+                const cancelled = await Promise.all([
+                    call('app.cancelCall', { id: 'slow' }),
+                    call('app.cancelCall', { id: 'queued' })
+                ]);
+                const responses = await Promise.all([slow, queued]);
+                const next = await call('os.callProcessPool', { id: poolId, data: { x: 2 } });
+                await call('os.destroyProcessPool', { id: poolId });
+                await __close(JSON.stringify({ cancelled, responses, next }));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.ok(output.cancelled.every((result) => result.success));
+            assert.ok(output.responses.every((response) => response.error.code == 'NE_RT_NATCNCL'));
+            assert.equal(output.next.returnValue.echo.x, 2);
+        });
+
+        it('fails the remaining requests when the pool is destroyed', async () => {
+            runner.run(POOL_HELPERS + `
+                const call = await __connect();
+                const poolId = await __createPool(call, 1);
+                const pending = call('os.callProcessPool', { id: poolId, data: { op: 'sleep' } });
+                const destroyed = await call('os.destroyProcessPool', { id: poolId });
+                const response = await pending;
+                const next = await call('os.callProcessPool', { id: poolId, data: { x: 1 } });
+                const destroyedAgain = await call('os.destroyProcessPool', { id: poolId });
+                await __close(JSON.stringify({ destroyed, response, next, destroyedAgain }));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.ok(output.destroyed.success);
+            assert.equal(output.response.error.code, 'NE_OS_INVPOOL');
+            assert.equal(output.next.error.code, 'NE_OS_INVPOOL');
+            assert.equal(output.destroyedAgain.error.code, 'NE_OS_INVPOOL');
+        });
+
+        it('fails a deferred call that can\'t be sent to a worker', async () => {
+            runner.run(POOL_HELPERS + `
+                const call = await __connect();
+                const poolId = await __createPool(call, 1);
+                await call('os.destroyProcessPool', { id: poolId });
+                const failed = await call('os.callProcessPool', { id: poolId, data: { x: 1 } });
+                const batch = await call('batch', { calls: [
+                    { method: 'os.callProcessPool', data: { id: poolId, data: { x: 2 } } },
+                    { method: 'os.getEnv', data: { key: 'PATH' } }
+                ]});
+                await __close(JSON.stringify({ failed, batch }));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.equal(output.failed.error.code, 'NE_OS_INVPOOL');
+            assert.equal(output.batch.returnValue[0].data.error.code, 'NE_OS_INVPOOL');
+            assert.ok(output.batch.returnValue[1].data.success);
+        });
+    });
+
     describe('os.getEnv', () => {
         it('returns an environment variable value', async () => {
             runner.run(`
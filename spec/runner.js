@@ -21,6 +21,35 @@ async function __close(data = "", exitCode = 0) {
     }, 2000);
 }
 
+// Sends native messages over a separate connection, so specs can choose the
+// message ids (i.e., for app.cancelCall) and read raw responses. The events
+// the connection receives are collected in the events array of the function.
+async function __connect() {
+    const token = window.NL_TOKEN || sessionStorage.getItem('NL_TOKEN');
+    const client = new WebSocket('ws://' + window.location.hostname + ':' + NL_PORT +
+        '?connectToken=' + token.split('.')[1]);
+    const pendingCalls = {};
+    const events = [];
+    let nextId = 0;
+    client.onmessage = (msg) => {
+        const message = JSON.parse(msg.data);
+        if(message.id && pendingCalls[message.id]) {
+            pendingCalls[message.id](message.data);
+            delete pendingCalls[message.id];
+        }
+        else if(message.event) {
+            events.push(message.event);
+        }
+    };
+    await new Promise((resolve) => client.onopen = resolve);
+    const call = (method, data, id = 'spec-' + nextId++) => {
+        client.send(JSON.stringify({id, method, accessToken: token, data}));
+        return new Promise((resolve) => pendingCalls[id] = resolve);
+    };
+    call.events = events;
+    return call;
+}
+
 async function __init() {
     try {
         await Neutralino.filesystem.createDirectory(NL_PATH + "/.tmp");
@@ -38,6 +67,8 @@ async function __init() {
 const TMP_DIR = '../bin/.tmp';
 const OUTPUT_FILE = '../bin/.tmp/output.txt';
 const SOURCE_FILE = '../bin/resources/js/main_spec.js';
+const RES_FILE = '../bin/resources.neu';
+const PACK_DIR = '../bin/.res_spec';
 
 function run(code, options = {}) {
     cleanup();
@@ -46,6 +77,16 @@ function run(code, options = {}) {
     }
     fs.writeFileSync(SOURCE_FILE, makeAppSource(code, options.beforeInitCode));
 
+    // Runs the app from a resources.neu packed with the spec source, and puts
+    // the original bundle back afterwards
+    let originalBundle = null;
+    if(options.bundle) {
+        if(fs.existsSync(RES_FILE)) {
+            originalBundle = fs.readFileSync(RES_FILE);
+        }
+        packResources();
+    }
+
     if(options.debug) {
         console.log('INFO: Running the app...');
     }
@@ -64,6 +105,14 @@ function run(code, options = {}) {
     if(options.debug) {
         console.log('INFO: Test app was closed...');
     }
+    if(options.bundle) {
+        if(originalBundle) {
+            fs.writeFileSync(RES_FILE, originalBundle);
+        }
+        else {
+            fs.rmSync(RES_FILE, { force: true });
+        }
+    }
     return exitCode;
 }
 
@@ -95,6 +144,16 @@ function makeCommand(optArgs = '') {
     return command;
 }
 
+function packResources() {
+    fs.rmSync(PACK_DIR, { recursive: true, force: true });
+    fs.mkdirSync(PACK_DIR);
+    fs.cpSync('../bin/resources', PACK_DIR + '/resources', { recursive: true });
+    fs.copyFileSync('../bin/neutralino.config.json', PACK_DIR + '/neutralino.config.json');
+    const python = process.platform == 'win32' ? 'python' : 'python3';
+    execSync(`${python} ../scripts/neupack.py ${PACK_DIR} ${RES_FILE}`);
+    fs.rmSync(PACK_DIR, { recursive: true });
+}
+
 function makeAppSource(code, beforeInitCode = '') {
     return SOURCE_TEMPLATE
         .replace('{CODE}', code)
@@ -2,6 +2,182 @@ const assert = require('assert');
 
 const runner = require('./runner');
 
+// Minimal CBOR and MessagePack codecs for the types native messages use, so
+// the binary protocols can be checked without adding client dependencies
+const BINARY_HELPERS = `
+    function __encodeMsgpack(value, out = []) {
+        const head = (code, length) => {
+            out.push(code, length >>> 24, (length >>> 16) & 0xff, (length >>> 8) & 0xff, length & 0xff);
+        };
+        if(value === null || value === undefined) out.push(0xc0);
+        else if(typeof value === 'boolean') out.push(value ? 0xc3 : 0xc2);
+        else if(Number.isInteger(value) && value >= 0 && value < 2 ** 32) head(0xce, value);
+        else if(typeof value === 'number') {
+            out.push(0xcb, ...new Uint8Array(new Float64Array([value]).buffer).reverse());
+        }
+        else if(typeof value === 'string') {
+            const bytes = new TextEncoder().encode(value);
+            head(0xdb, bytes.length);
+            out.push(...bytes);
+        }
+        else if(value instanceof Uint8Array) {
+            head(0xc6, value.length);
+            out.push(...value);
+        }
+        else if(Array.isArray(value)) {
+            head(0xdd, value.length);
+            value.forEach((item) => __encodeMsgpack(item, out));
+        }
+        else {
+            head(0xdf, Object.keys(value).length);
+            Object.entries(value).forEach(([key, item]) => {
+                __encodeMsgpack(key, out);
+                __encodeMsgpack(item, out);
+            });
+        }
+        return out;
+    }
+
+    function __encodeCbor(value, out = []) {
+        const head = (major, length) => {
+            out.push(major << 5 | 26, length >>> 24, (length >>> 16) & 0xff, (length >>> 8) & 0xff, length & 0xff);
+        };
+        if(value === null || value === undefined) out.push(0xf6);
+        else if(typeof value === 'boolean') out.push(value ? 0xf5 : 0xf4);
+        else if(Number.isInteger(value) && value >= 0 && value < 2 ** 32) head(0, value);
+        else if(typeof value === 'number') {
+            out.push(0xfb, ...new Uint8Array(new Float64Array([value]).buffer).reverse());
+        }
+        else if(typeof value === 'string') {
+            const bytes = new TextEncoder().encode(value);
+            head(3, bytes.length);
+            out.push(...bytes);
+        }
+        else if(value instanceof Uint8Array) {
+            head(2, value.length);
+            out.push(...value);
+        }
+        else if(Array.isArray(value)) {
+            head(4, value.length);
+            value.forEach((item) => __encodeCbor(item, out));
+        }
+        else {
+            head(5, Object.keys(value).length);
+            Object.entries(value).forEach(([key, item]) => {
+                __encodeCbor(key, out);
+                __encodeCbor(item, out);
+            });
+        }
+        return out;
+    }
+
+    function __makeByteReader(bytes) {
+        const reader = { pos: 0, view: new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength) };
+        reader.byte = () => bytes[reader.pos++];
+        reader.uint = (size) => {
+            let number = 0;
+            for(let i = 0; i < size; i++) number = number * 256 + bytes[reader.pos++];
+            return number;
+        };
+        reader.float = (size) => {
+            reader.pos += size;
+            return size === 4 ? reader.view.getFloat32(reader.pos - 4) : reader.view.getFloat64(reader.pos - 8);
+        };
+        reader.raw = (length) => bytes.slice(reader.pos, reader.pos += length);
+        reader.str = (length) => new TextDecoder().decode(reader.raw(length));
+        reader.list = (length, read) => Array.from({ length }, read);
+        reader.map = (length, read) => {
+            const object = {};
+            for(let i = 0; i < length; i++) {
+                const key = read();
+                object[key] = read();
+            }
+            return object;
+        };
+        return reader;
+    }
+
+    function __decodeMsgpack(bytes) {
+        const reader = __makeByteReader(bytes);
+        const read = () => {
+            const code = reader.byte();
+            if(code < 0x80) return code;
+            if(code < 0x90) return reader.map(code & 0x0f, read);
+            if(code < 0xa0) return reader.list(code & 0x0f, read);
+            if(code < 0xc0) return reader.str(code & 0x1f);
+            if(code >= 0xe0) return code - 256;
+            if(code === 0xc0) return null;
+            if(code === 0xc2 || code === 0xc3) return code === 0xc3;
+            if(code >= 0xc4 && code <= 0xc6) return reader.raw(reader.uint(1 << (code - 0xc4)));
+            if(code === 0xca || code === 0xcb) return reader.float(code === 0xca ? 4 : 8);
+            if(code >= 0xcc && code <= 0xcf) return reader.uint(1 << (code - 0xcc));
+            if(code >= 0xd0 && code <= 0xd3) {
+                const size = 1 << (code - 0xd0);
+                const number = reader.uint(size);
+                return number >= 2 ** (size * 8 - 1) ? number - 2 ** (size * 8) : number;
+            }
+            if(code >= 0xd9 && code <= 0xdb) return reader.str(reader.uint(1 << (code - 0xd9)));
+            if(code === 0xdc || code === 0xdd) return reader.list(reader.uint(code === 0xdc ? 2 : 4), read);
+            if(code === 0xde || code === 0xdf) return reader.map(reader.uint(code === 0xde ? 2 : 4), read);
+            throw new Error('Unsupported MessagePack type: ' + code);
+        };
+        return read();
+    }
+
+    function __decodeCbor(bytes) {
+        const reader = __makeByteReader(bytes);
+        const read = () => {
+            const initial = reader.byte();
+            const major = initial >> 5;
+            const info = initial & 0x1f;
+            if(major === 7) {
+                if(info === 20 || info === 21) return info === 21;
+                if(info === 22) return null;
+                if(info === 26 || info === 27) return reader.float(info === 26 ? 4 : 8);
+                throw new Error('Unsupported CBOR simple value: ' + info);
+            }
+            const length = info < 24 ? info : reader.uint(1 << (info - 24));
+            switch(major) {
+                case 0: return length;
+                case 1: return -1 - length;
+                case 2: return reader.raw(length);
+                case 3: return reader.str(length);
+                case 4: return reader.list(length, read);
+                case 5: return reader.map(length, read);
+                default: return read(); // Tags only wrap the next item
+            }
+        };
+        return read();
+    }
+
+    // Like __connect, but sends and receives binary native messages
+    async function __connectBinary(protocol) {
+        const encode = protocol === 'cbor' ? __encodeCbor : __encodeMsgpack;
+        const decode = protocol === 'cbor' ? __decodeCbor : __decodeMsgpack;
+        const token = window.NL_TOKEN || sessionStorage.getItem('NL_TOKEN');
+        const client = new WebSocket('ws://' + window.location.hostname + ':' + NL_PORT +
+            '?connectToken=' + token.split('.')[1] + '&protocol=' + protocol);
+        client.binaryType = 'arraybuffer';
+        const pendingCalls = {};
+        let nextId = 0;
+        client.onmessage = (msg) => {
+            const message = typeof msg.data === 'string' ? JSON.parse(msg.data) :
+                decode(new Uint8Array(msg.data));
+            if(message.id && pendingCalls[message.id]) {
+                pendingCalls[message.id]({ binary: typeof msg.data !== 'string', data: message.data });
+                delete pendingCalls[message.id];
+            }
+        };
+        await new Promise((resolve) => client.onopen = resolve);
+        return (method, data, text = false) => {
+            const id = 'spec-' + nextId++;
+            const message = { id, method, accessToken: token, data };
+            client.send(text ? JSON.stringify(message) : new Uint8Array(encode(message)));
+            return new Promise((resolve) => pendingCalls[id] = resolve);
+        };
+    }
+`;
+
 describe('server.spec: server namespace tests', () => {
 
     describe('server.mount', () => {
@@ -71,6 +247,323 @@ describe('server.spec: server namespace tests', () => {
             assert.ok(typeof output === 'object', 'Expected output is an object');
             assert.ok(output.fetch1 === 200, 'The file request to a mounted directory succeeds');
         });
+        it('streams large files and caps byte ranges', async () => {
+            runner.run(`
+                const response = {};
+                const targetPath = NL_PATH + '/.tmp/test-mount-large';
+                const size = 20 * 1024 * 1024;
+                const data = new Uint8Array(size);
+                for(let i = 0; i < size; i += 4096) {
+                    data[i] = (i / 4096) % 256;
+                }
+                data[size - 1] = 42;
+                await Neutralino.filesystem.createDirectory(targetPath);
+                await Neutralino.filesystem.writeBinaryFile(targetPath + '/large.bin', data.buffer);
+
+                await Neutralino.server.mount('/large', targetPath);
+
+                const fetch1 = await fetch('/large/large.bin', { cache: 'no-store' });
+                const body1 = new Uint8Array(await fetch1.arrayBuffer());
+                response.fetch1 = fetch1.status;
+                response.size1 = body1.byteLength;
+                response.same1 = body1.every((value, index) => value === data[index]);
+
+                const fetch2 = await fetch('/large/large.bin', {
+                    cache: 'no-store',
+                    headers: { Range: 'bytes=0-' + (size - 2) }
+                });
+                const body2 = new Uint8Array(await fetch2.arrayBuffer());
+                response.fetch2 = fetch2.status;
+                response.size2 = body2.byteLength;
+                response.range2 = fetch2.headers.get('Content-Range');
+
+                await Neutralino.server.unmount('/large');
+
+                await __close(JSON.stringify(response));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.ok(typeof output === 'object', 'Expected output is an object');
+            assert.ok(output.fetch1 === 200, 'Expected a full request to a large file to succeed');
+            assert.ok(output.size1 === 20971520, 'Expected the whole large file to be sent');
+            assert.ok(output.same1 === true, 'Expected the streamed file to match the written file');
+            assert.ok(output.fetch2 === 206, 'Expected a range request to a large file to succeed');
+            assert.ok(output.size2 === 8388608, 'Expected a bounded range to be capped to 8 MiB');
+            assert.ok(output.range2 === 'bytes 0-8388607/20971520', 'Expected the capped range in Content-Range');
+        });
+    });
+
+    describe('static server', () => {
+        it('answers conditional requests with 304 until the file changes', async () => {
+            runner.run(`
+                const response = {};
+                const targetPath = NL_PATH + '/.tmp/test-mount-cache';
+                const url = '/cache/test.txt';
+                await Neutralino.filesystem.createDirectory(targetPath);
+                await Neutralino.filesystem.writeFile(targetPath + '/test.txt', 'Hello');
+                await Neutralino.server.mount('/cache', targetPath);
+
+                const fetch1 = await fetch(url, { cache: 'no-store' });
+                const etag = fetch1.headers.get('ETag');
+                const lastModified = fetch1.headers.get('Last-Modified');
+                response.fetch1 = fetch1.status;
+                response.hasValidators = !!etag && !!lastModified;
+
+                const fetch2 = await fetch(url, { cache: 'no-store', headers: { 'If-None-Match': etag } });
+                response.fetch2 = fetch2.status;
+                response.body2 = await fetch2.text();
+
+                const fetch3 = await fetch(url, { cache: 'no-store', headers: { 'If-None-Match': '"other"' } });
+                response.fetch3 = fetch3.status;
+
+                const fetch4 = await fetch(url, { cache: 'no-store', headers: { 'If-Modified-Since': lastModified } });
+                response.fetch4 = fetch4.status;
+
+                // Waits for a new modification time on file systems with a coarse one
+                await new Promise((resolve) => setTimeout(resolve, 1100));
+                await Neutralino.filesystem.writeFile(targetPath + '/test.txt', 'Hello again');
+                const fetch5 = await fetch(url, { cache: 'no-store', headers: { 'If-None-Match': etag } });
+                response.fetch5 = fetch5.status;
+                response.body5 = await fetch5.text();
+                response.etagChanged = fetch5.headers.get('ETag') !== etag;
+
+                await Neutralino.server.unmount('/cache');
+                await __close(JSON.stringify(response));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.ok(output.fetch1 === 200, 'Expected the first request to succeed');
+            assert.ok(output.hasValidators === true, 'Expected ETag and Last-Modified headers');
+            assert.ok(output.fetch2 === 304, 'Expected 304 for a matching If-None-Match');
+            assert.equal(output.body2, '', 'Expected no body with 304');
+            assert.ok(output.fetch3 === 200, 'Expected 200 for a different If-None-Match');
+            assert.ok(output.fetch4 === 304, 'Expected 304 for a matching If-Modified-Since');
+            assert.ok(output.fetch5 === 200, 'Expected 200 after the file changed');
+            assert.equal(output.body5, 'Hello again', 'Expected the changed file');
+            assert.ok(output.etagChanged === true, 'Expected a new ETag after the file changed');
+        });
+
+        // Browsers don't let pages choose Accept-Encoding, so a node client
+        // sends the requests and writes the precompressed siblings
+        it('negotiates precompressed br and gzip siblings with Accept-Encoding', async () => {
+            runner.run(`
+                const targetPath = NL_PATH + '/.tmp/test-mount-encoding';
+                const script = NL_PATH + '/.tmp/encoding-client.js';
+                await Neutralino.filesystem.createDirectory(targetPath);
+                await Neutralino.filesystem.writeFile(script, [
+                    "const http = require('http');",
+                    "const zlib = require('zlib');",
+                    "const fs = require('fs');",
+                    "const [host, port, dir] = process.argv.slice(2);",
+                    "const text = 'Hello Neutralinojs! '.repeat(200);",
+                    "fs.writeFileSync(dir + '/app.txt', text);",
+                    "fs.writeFileSync(dir + '/app.txt.br', zlib.brotliCompressSync(text));",
+                    "fs.writeFileSync(dir + '/app.txt.gz', zlib.gzipSync(text));",
+                    "fs.writeFileSync(dir + '/plain.txt', text);",
+                    "const get = (path, acceptEncoding) => new Promise((resolve, reject) => {",
+                    "    http.get({ host, port, path, headers: { 'Accept-Encoding': acceptEncoding } }, (res) => {",
+                    "        const chunks = [];",
+                    "        res.on('data', (chunk) => chunks.push(chunk));",
+                    "        res.on('end', () => {",
+                    "            const encoding = res.headers['content-encoding'] || 'identity';",
+                    "            let body = Buffer.concat(chunks);",
+                    "            if(encoding === 'br') body = zlib.brotliDecompressSync(body);",
+                    "            if(encoding === 'gzip') body = zlib.gunzipSync(body);",
+                    "            resolve({ status: res.statusCode, encoding, vary: res.headers['vary'], same: body.toString() === text });",
+                    "        });",
+                    "    }).on('error', reject);",
+                    "});",
+                    "(async () => {",
+                    "    const results = {};",
+                    "    results.br = await get('/encoding/app.txt', 'gzip, deflate, br');",
+                    "    results.gzip = await get('/encoding/app.txt', 'gzip, deflate');",
+                    "    results.noBr = await get('/encoding/app.txt', 'br;q=0, gzip');",
+                    "    results.identity = await get('/encoding/app.txt', '');",
+                    "    results.noSibling = await get('/encoding/plain.txt', 'gzip, br');",
+                    "    console.log(JSON.stringify(results));",
+                    "})();"
+                ].join('\\n'));
+                await Neutralino.server.mount('/encoding', targetPath);
+                const info = await Neutralino.os.execCommand('node "' + script + '" ' +
+                    window.location.hostname + ' ' + NL_PORT + ' "' + targetPath + '"');
+                await Neutralino.server.unmount('/encoding');
+                await __close(info.stdOut.trim());
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.equal(output.br.encoding, 'br', 'Expected the br sibling if the client accepts br');
+            assert.equal(output.gzip.encoding, 'gzip', 'Expected the gz sibling if the client only accepts gzip');
+            assert.equal(output.noBr.encoding, 'gzip', 'Expected no br with q=0');
+            assert.equal(output.identity.encoding, 'identity', 'Expected the plain file without Accept-Encoding');
+            assert.equal(output.noSibling.encoding, 'identity',
+                'Expected the plain file without siblings if on-the-fly compression is disabled');
+            for(const result of Object.values(output)) {
+                assert.equal(result.status, 200);
+                assert.ok(result.same, 'Expected the decoded body to match the original file');
+                assert.equal(result.vary, 'Accept-Encoding');
+            }
+        });
+    });
+
+    describe('native message protocol', () => {
+        it('runs batched calls in order and keeps errors within each call', async () => {
+            runner.run(`
+                const call = await __connect();
+                const path = NL_PATH + '/.tmp/batch.txt';
+                const response = await call('batch', { calls: [
+                    { id: 'write', method: 'filesystem.writeFile', data: { path, data: 'Hello' } },
+                    { id: 'append', method: 'filesystem.appendFile', data: { path, data: ' World' } },
+                    { id: 'read', method: 'filesystem.readFile', data: { path } },
+                    { id: 'missing', method: 'filesystem.readFile', data: { path: NL_PATH + '/.tmp/missing.txt' } },
+                    { id: 'unknown', method: 'spec.unknownMethod' },
+                    { id: 'noMethod' },
+                    { id: 'readAgain', method: 'filesystem.readFile', data: { path } }
+                ]});
+                await __close(JSON.stringify(response));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.ok(output.success === true, 'Expected the batch to succeed even if some calls fail');
+            const calls = output.returnValue;
+            assert.deepEqual(calls.map((call) => call.id),
+                ['write', 'append', 'read', 'missing', 'unknown', 'noMethod', 'readAgain']);
+            assert.ok(calls[0].data.success && calls[1].data.success);
+            assert.equal(calls[2].data.returnValue, 'Hello World', 'Expected the calls to run in order');
+            assert.equal(calls[3].data.error.code, 'NE_FS_FILRDER');
+            assert.equal(calls[4].data.error.code, 'NE_RT_NATNTIM');
+            assert.equal(calls[5].data.error.code, 'NE_RT_NATRTER');
+            assert.equal(calls[6].data.returnValue, 'Hello World', 'Expected calls after failed ones to run');
+        });
+
+        for(const protocol of ['cbor', 'msgpack']) {
+            it('sends and receives ' + protocol + ' native messages with raw binary values', async () => {
+                runner.run(BINARY_HELPERS + `
+                    const response = {};
+                    const call = await __connectBinary('${protocol}');
+                    const path = NL_PATH + '/.tmp/binary-protocol.bin';
+                    const bytes = new Uint8Array([0, 1, 2, 127, 128, 255]);
+
+                    const write = await call('filesystem.writeBinaryFile', { path, data: bytes });
+                    response.write = write.binary && write.data.success;
+
+                    const read = await call('filesystem.readBinaryFile', { path });
+                    response.isBytes = read.data.returnValue instanceof Uint8Array;
+                    response.bytes = Array.from(read.data.returnValue);
+
+                    await Neutralino.filesystem.writeFile(path, 'Hello ✓');
+                    response.text = (await call('filesystem.readFile', { path })).data.returnValue;
+                    response.stats = (await call('filesystem.getStats', { path })).data.returnValue.size;
+                    response.error = (await call('filesystem.readFile', { path: path + '.missing' })).data.error.code;
+
+                    // Text requests still get JSON responses, with base64 binary values
+                    const textRead = await call('filesystem.readBinaryFile', { path }, true);
+                    response.textBinary = textRead.binary;
+                    response.textBase64 = textRead.data.returnValue;
+                    await __close(JSON.stringify(response));
+                `);
+                const output = JSON.parse(runner.getOutput());
+                assert.ok(output.write === true, 'Expected a binary response to a binary write');
+                assert.ok(output.isBytes === true, 'Expected binary values as raw byte strings');
+                assert.deepEqual(output.bytes, [0, 1, 2, 127, 128, 255]);
+                assert.equal(output.text, 'Hello ✓');
+                assert.equal(output.stats, 9);
+                assert.equal(output.error, 'NE_FS_FILRDER');
+                assert.ok(output.textBinary === false, 'Expected a text response to a text request');
+                assert.equal(output.textBase64, Buffer.from('Hello ✓').toString('base64'));
+            });
+        }
+    });
+
+    // Stresses the connection registry with clients that connect, subscribe, and
+    // disconnect while events are broadcast, and the mounts with assets that are
+    // fetched while a directory gets mounted and unmounted. To check for data races, build with
+    // -DNEU_SANITIZE=thread and run this spec with
+    // TSAN_OPTIONS="suppressions=$PWD/tsan.supp" node index.js server
+    describe('connection registry', () => {
+        it('keeps serving while clients connect and disconnect during broadcasts', async () => {
+            let exitCode = runner.run(`
+                const token = window.NL_TOKEN || sessionStorage.getItem('NL_TOKEN');
+                const url = 'ws://' + window.location.hostname + ':' + NL_PORT +
+                    '?connectToken=' + token.split('.')[1];
+                let running = true;
+                let connects = 0;
+                let received = 0;
+                let broadcasts = 0;
+                let mounts = 0;
+                let fetches = 0;
+                let fetchStatuses = new Set();
+                const mountTarget = NL_PATH + '/.tmp/stress-mount';
+                await Neutralino.filesystem.createDirectory(mountTarget);
+                await Neutralino.filesystem.writeFile(mountTarget + '/test.txt', 'Hello');
+
+                async function connectClients(i) {
+                    while(running) {
+                        await new Promise((resolve) => {
+                            const client = new WebSocket(url);
+                            client.onopen = () => {
+                                if(i % 3 != 0) {
+                                    client.send(JSON.stringify({
+                                        id: String(connects),
+                                        method: i % 3 == 1 ? 'subscribe' : 'unsubscribe',
+                                        accessToken: token,
+                                        data: { events: ['stress*', 'otherEvent'] }
+                                    }));
+                                }
+                                setTimeout(() => client.close(), i * 5);
+                            };
+                            client.onmessage = () => received++;
+                            client.onclose = resolve;
+                            client.onerror = resolve;
+                        });
+                        connects++;
+                    }
+                }
+
+                async function broadcastEvents() {
+                    while(running) {
+                        await Promise.all([
+                            Neutralino.events.broadcast('stressEvent', broadcasts),
+                            Neutralino.events.broadcast('otherEvent', broadcasts)
+                        ]);
+                        broadcasts++;
+                    }
+                }
+
+                async function remountDirectory() {
+                    while(running) {
+                        await Neutralino.server.mount('/stress', mountTarget);
+                        await Neutralino.server.unmount('/stress');
+                        mounts++;
+                    }
+                }
+
+                async function fetchAssets() {
+                    while(running) {
+                        const response = await fetch('/stress/test.txt', { cache: 'no-store' });
+                        fetchStatuses.add(response.status);
+                        fetches++;
+                    }
+                }
+
+                const tasks = [broadcastEvents(), broadcastEvents(), remountDirectory(), fetchAssets(), fetchAssets()];
+                for(let i = 0; i < 8; i++) {
+                    tasks.push(connectClients(i));
+                }
+                await new Promise((resolve) => setTimeout(resolve, 5000));
+                running = false;
+                await Promise.all(tasks);
+
+                let alive = await Neutralino.os.getEnv('PATH') != '';
+                fetchStatuses = [...fetchStatuses];
+                await __close(JSON.stringify({connects, received, broadcasts, mounts, fetches, fetchStatuses, alive}));
+            `);
+            const output = JSON.parse(runner.getOutput());
+            assert.ok(exitCode === 0, 'Expected the app to exit without errors');
+            assert.ok(output.connects > 0, 'Expected clients to connect');
+            assert.ok(output.broadcasts > 0, 'Expected events to be broadcast');
+            assert.ok(output.received > 0, 'Expected clients to receive events');
+            assert.ok(output.mounts > 0, 'Expected the directory to get mounted and unmounted');
+            assert.ok(output.fetches > 0, 'Expected assets to be fetched');
+            assert.ok(output.fetchStatuses.every((status) => status == 200 || status == 404),
+                'Expected mounted assets to be served or not found');
+            assert.ok(output.alive, 'Expected the app connection to keep working');
+        });
     });
 
 });
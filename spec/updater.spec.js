@@ -125,6 +125,25 @@ describe('updater.spec: updater namespace tests', () => {
             `, { args: '--port=8080' });
             assert.equal(runner.getOutput(), 'ok');
         });
+
+        it('replaces resources.neu while the app reads resources from it', async () => {
+            runner.run(`
+                await Neutralino.updater
+                    .checkForUpdates('http://127.0.0.1:8080/updater_test/update_info.json');
+                const before = await Neutralino.resources.readFile('/resources/index_spec.html');
+
+                await Neutralino.updater.install();
+                let stats = await Neutralino.filesystem.getStats(NL_PATH + '/resources.neu');
+                // The running app keeps serving the old bundle
+                const after = await Neutralino.resources.readFile('/resources/index_spec.html');
+                const response = await fetch('/index_spec.html');
+
+                if(NL_RESMODE == 'bundle' && stats.isFile && before == after && response.ok) {
+                    await __close('ok');
+                }
+            `, { args: '--port=8080 --res-mode=bundle', bundle: true });
+            assert.equal(runner.getOutput(), 'ok');
+        });
        
         it('throws an error if no update manifest is loaded', async () => {
             runner.run(`